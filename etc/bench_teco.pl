@@ -0,0 +1,86 @@
+#!/usr/bin/perl
+
+#
+#  bench_teco.pl - Time TECO benchmark macros with one or more executables.
+#
+#  @copyright 2023 Franklin P. Johnston / Nowwith Treble Software
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a
+#  copy of this software and associated documentation files (the "Software"),
+#  to deal in the Software without restriction, including without limitation
+#  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+#  and/or sell copies of the Software, and to permit persons to whom the
+#  Software is furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in
+#  all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+#  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#  THE SOFTWARE.
+#
+#  Usage: bench_teco.pl [--runs=n] --teco=exe [--teco=exe...] macro...
+#
+#  Each macro is executed with each TECO executable, and the best elapsed
+#  time of n runs is printed in a table, with one row per macro and one
+#  column per executable.
+#
+################################################################################
+
+use strict;
+use warnings;
+use version; our $VERSION = '1.0.0';
+
+use Carp;
+use English qw( -no_match_vars );
+use File::Basename;
+use Getopt::Long;
+use Time::HiRes qw( time );
+
+my $runs = 3;
+my @tecos;
+
+GetOptions(
+    'runs=i' => \$runs,
+    'teco=s' => \@tecos,
+) or croak 'Invalid option';
+
+croak 'No TECO executables specified' if !@tecos;
+croak 'No benchmark macros specified' if !@ARGV;
+
+printf '%-20s', 'Benchmark';
+printf '%16s', basename($_) foreach @tecos;
+print "\n";
+
+foreach my $macro (@ARGV)
+{
+    printf '%-20s', basename( $macro, '.tec' );
+
+    foreach my $teco (@tecos)
+    {
+        my $best;
+
+        for ( 1 .. $runs )
+        {
+            my $start = time;
+
+            system "$teco -n -E $macro > /dev/null 2>&1";
+
+            croak "$teco failed for $macro" if $CHILD_ERROR != 0;
+
+            my $elapsed = time - $start;
+
+            $best = $elapsed if !defined $best || $elapsed < $best;
+        }
+
+        printf '%15.3fs', $best;
+    }
+
+    print "\n";
+}
+
+exit 0;
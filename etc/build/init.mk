@@ -4,16 +4,17 @@ buffer  ?= gap
 display ?= 1
 int     ?= 32
 paging  ?= vm
+threads ?= on
 
 #  Edit buffer options.
 
 ifeq (${buffer}, gap)               # Did user ask for a gap buffer?
 
-    # Nothing to remove if gap buffer.
+    EXCLUDES += rope_buf.c
 
 else ifeq (${buffer}, rope)         # Did user ask for a rope buffer?
 
-    $(error Rope buffer handler is not yet implemented)
+    EXCLUDES += gap_buf.c
 
 else                                # We don't know what the user wants
 
@@ -66,11 +67,15 @@ else ifeq (${paging}, std)          # Did user ask for standard TECO paging?
 
 else ifeq (${paging}, file)         # Did user ask for holding file paging?
 
-    #  This is a placeholder for eventual implementation of a method for using
-    #  a "holding file" to allow backwards paging, as described in The Craft of
-    #  Text Editing, by Craig A. Finseth.
+    EXCLUDES += page_std.c page_vm.c
+    DEFINES += -D PAGE_FILE
+    DOXYGEN += PAGE_FILE
 
-    $(error Holding file paging is not yet implemented)
+    ifdef page_mem                  # Limit on memory used for pages
+
+        DEFINES += -D PAGE_MEM=${page_mem}
+
+    endif
 
 else                                # We don't know what the user wants
 
@@ -78,6 +83,21 @@ else                                # We don't know what the user wants
 
 endif
 
+#  Search thread options.
+
+ifeq (${threads}, on)               # Did user ask for search threads?
+
+    CFLAGS   += -pthread
+    LINKOPTS += -pthread
+    DEFINES  += -D THREADS
+    DOXYGEN  +=    THREADS
+
+else ifneq (${threads}, off)        # We don't know what the user wants
+
+    $(error Unknown threads option: ${threads}: expected on or off)
+
+endif
+
 #  Debugging and compiler optimization options.
 
 ifdef   gdb                         # Can't build for both gdb and gprof
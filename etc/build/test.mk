@@ -100,6 +100,18 @@ endif
 test:
 	@$(MAKE) debug=2 teco
 
+#
+#  Define target to measure the throughput of each code path used to count
+#  line delimiters and words (see src/delims.c).
+#
+
+.PHONY: bench-delims
+bench-delims: test/bench/delims_bench.c src/delims.c
+	@mkdir -p bin
+	$(CC) -std=gnu11 -Wall -Wextra -Ofast -funsigned-char -D NDEBUG -I $(INCLUDE) \
+		-o bin/delims_bench $<
+	bin/delims_bench
+
 #
 #  Define target to smoke test scripts, files, and executable image.
 #
@@ -115,10 +127,32 @@ smoke: distclean $(CRITIC) $(LINT) test
 	@echo Testing TECO commands...
 	etc/test_commands.pl test/
 
+#
+#  Define target to compare performance of the gap buffer and rope buffer
+#  handlers, using the benchmark macros in test/bench/.
+#
+
+BENCH_MACROS = $(wildcard test/bench/*.tec)
+
+.PHONY: bench
+bench:
+	@$(MAKE) clean
+	@$(MAKE) buffer=gap ndebug=1 teco
+	@mv bin/teco bin/teco-gap
+	@$(MAKE) clean
+	@$(MAKE) buffer=rope ndebug=1 teco
+	@mv bin/teco bin/teco-rope
+	@$(MAKE) clean
+	etc/bench_teco.pl --teco=bin/teco-gap --teco=bin/teco-rope $(BENCH_MACROS)
+
 else
 
 .PHONY: smoke
 smoke:
 	@$(error Make target '$@' requires Perl)
 
+.PHONY: bench
+bench:
+	@$(error Make target '$@' requires Perl)
+
 endif
@@ -230,6 +230,7 @@ static const struct cmd_table e_table[] =
     ENTRY('2',         scan_flag2,       exec_E2         ),
     ENTRY('3',         scan_flag2,       exec_E3         ),
     ENTRY('4',         scan_flag2,       exec_E4         ),
+    ENTRY('5',         scan_flag2,       exec_E5         ),
     ENTRY('A',         NULL,             exec_EA         ),
     ENTRY('a',         NULL,             exec_EA         ),
     ENTRY('B',         scan_ER,          exec_EB         ),
@@ -309,6 +310,8 @@ static const struct cmd_table f_table[] =
     ENTRY('f',         scan_FF,          exec_FF         ),
     ENTRY('H',         scan_FH,          NULL            ),
     ENTRY('h',         scan_FH,          NULL            ),
+    ENTRY('I',         scan_FI,          exec_FI         ),
+    ENTRY('i',         scan_FI,          exec_FI         ),
     ENTRY('K',         scan_FK,          exec_FK         ),
     ENTRY('k',         scan_FK,          exec_FK         ),
     ENTRY('L',         scan_case,        exec_FL         ),
@@ -325,6 +328,8 @@ static const struct cmd_table f_table[] =
     ENTRY('s',         scan_FS,          exec_FS         ),
     ENTRY('U',         scan_case,        exec_FU         ),
     ENTRY('u',         scan_case,        exec_FU         ),
+    ENTRY('W',         scan_FW,          exec_FW         ),
+    ENTRY('w',         scan_FW,          exec_FW         ),
     ENTRY('Z',         scan_FZ,          NULL            ),
     ENTRY('z',         scan_FZ,          NULL            ),
     ENTRY('_',         scan_F_under,     exec_F_under    ),
@@ -116,6 +116,7 @@ static struct errlist errlist[] =
     [E_SNI] = { "SNI",  "Semi-colon not in iteration" },
     [E_SRH] = { "SRH",  "Search failure: '%s'" },
     [E_TAG] = { "TAG",  "Missing tag: '!%s!'" },
+    [E_TMQ] = { "TMQ",  "Too many Q-registers" },
     [E_TXT] = { "TXT",  "Invalid text delimiter '%s'" },
     [E_UTC] = { "UTC",  "Unterminated command string" },
     [E_UTM] = { "UTM",  "Unterminated macro" },
@@ -303,6 +304,8 @@ static const char *errhelp[] =
     [E_TAG] = "The tag specified by an O command cannot "
               "be found. This tag must be in the same macro "
               "level as the O command referencing it.",
+    [E_TMQ] = "More Q-registers were specified for an FW "
+              "command than the four counts it returns.",
     [E_TXT] = "Text delimiters must be graphic ASCII characters "
               "in the range of [33,126], or control characters "
               "in the range of [1,26]. Characters such as spaces "
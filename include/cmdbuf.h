@@ -28,10 +28,79 @@
 
 #define _CBUF_H
 
+///  @struct  text_scan
+///  @brief   Result of scanning a text argument in a macro, saved so that the
+///           text doesn't have to be scanned again each time a loop repeats
+///           the command.
+
+struct text_scan
+{
+    uint_t len;                     ///< Length of text string
+    uint_t lines;                   ///< No. of LFs in string and delimiter
+    char delim;                     ///< Closing delimiter (NUL if not scanned)
+    bool tail;                      ///< true if closing delimiter was found
+};
+
+///  @struct  jump
+///  @brief   Result of skipping to the end of a loop or conditional from some
+///           position in a macro, saved so that later skips from the same
+///           position don't have to scan the commands again.
+
+struct jump
+{
+    uint_t end;                     ///< Position after last command skipped
+    uint_t lines;                   ///< No. of LFs skipped
+    int depth;                      ///< Change in conditional depth
+    int low;                        ///< Lowest conditional depth reached
+    char type;                      ///< Type of skip (NUL if not skipped)
+};
+
+///  @struct  cache_table
+///  @brief   Hash table of scan data, keyed by position in a command string.
+///           Only positions at which something has been scanned have an
+///           entry, so the table's size depends on how much of the macro has
+///           been executed, not on its length.
+
+struct cache_table
+{
+    void *slots;                    ///< Entries (NULL if none allocated)
+    uint_t size;                    ///< No. of slots (a power of 2)
+    uint_t count;                   ///< No. of slots in use
+    uint bits;                      ///< No. of bits in slot no.
+};
+
+///  @struct  cmd_cache
+///  @brief   Text-scan cache for a macro. The cache belongs to the Q-register
+///           the macro is stored in, and is released when its text changes,
+///           but it isn't freed until any macros using it have returned.
+
+struct cmd_cache
+{
+    uint refs;                      ///< No. of references to cache
+    uint_t len;                     ///< Length of command string
+    struct cache_table text;        ///< Text arguments, by starting position
+    struct tags *tags;              ///< Tags (for O commands)
+    struct cache_table jump;        ///< Skips, by starting position
+    int_t e1;                       ///< E1 flag when skips were saved
+    int_t e2;                       ///< E2 flag when skips were saved
+};
+
 // Command buffer variable
 
 extern tbuffer *cbuf;
 
+// Command cache functions
+
+extern void free_cache(struct cmd_cache **cache);
+
+extern struct jump *get_jump(struct cmd_cache *cache, uint_t pos);
+
+extern struct text_scan *get_text(struct cmd_cache *cache, uint_t pos);
+
+extern void free_tags(struct tags **tags);
+
+extern struct cmd_cache *new_cache(uint_t len);
+
 // Command buffer functions
 
 extern void init_cbuf(void);
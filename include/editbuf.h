@@ -47,7 +47,7 @@ struct edit
     int len;                    ///< Length of current line in bytes
     int pos;                    ///< Position in line
     int line;                   ///< Current line number (0+)
-    int nlines;                 ///< Total no. of lines
+    int nlines;                 ///< Total no. of lines (delimiters)
 };
 
 extern const struct edit *t;    ///< Read-only pointer to text in edit buffer
@@ -60,6 +60,19 @@ extern bool append_edit(struct ifile *ifile, bool single);
 
 extern void change_dot(int c);
 
+//  Check whether input file used as edit buffer has changed.
+
+extern void check_edit(void);
+
+//  Count line delimiters in a block of text.
+
+extern uint_t count_delims(const uchar *p, uint_t nbytes);
+
+//  Count words and line delimiters in a block of text.
+
+extern uint_t count_words(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                          bool *space);
+
 //  Delete nbytes at dot. Argument can be positive or negative.
 
 extern void delete_edit(int_t nbytes);
@@ -97,6 +110,15 @@ extern void move_dot(int_t delta);
 
 extern int read_edit(int_t relpos);
 
+// Get contiguous span of text in buffer that ends before a position relative
+// to dot, and that starts no earlier than another position relative to dot.
+// This is the reverse of span_edit(), for use when reading backward.
+//
+// Returns: no. of bytes in span, or 0 if there is no text in the range. The
+//          text pointer is set to the start of the span.
+
+extern uint_t rspan_edit(int_t start, int_t end, const uchar **text);
+
 // Set dot to absolute position.
 
 extern void set_dot(int_t pos);
@@ -105,4 +127,14 @@ extern void set_dot(int_t pos);
 
 extern uint_t size_edit(uint_t size);
 
+// Get contiguous span of text in buffer, starting at position relative to dot
+// and ending before another position relative to dot. Spans cannot cross the
+// gap in a gap buffer (or a chunk boundary in a rope buffer), so reading an
+// arbitrary range may require more than one call.
+//
+// Returns: no. of bytes in span, or 0 if there is no text in the range. The
+//          text pointer is only valid until the edit buffer is next changed.
+
+extern uint_t span_edit(int_t start, int_t end, const uchar **text);
+
 #endif  // !defined(_EDITBUF_H)
@@ -182,6 +182,7 @@ union ed_flag
         uint movedot   : 1;     ///< Move dot by one on multiple occurrence searches
         uint           : 1;     ///< (Automatic refresh inhibit)
         uint nobuffer  : 1;     ///< Flush output immediately
+        uint noshrink  : 1;     ///< Don't release memory after deletions
     };
 };
 
@@ -272,6 +273,7 @@ struct flags
     union  e2_flag e2;          ///< Command restrictions
     union  e3_flag e3;          ///< File I/O features
     union  e4_flag e4;          ///< Display mode flags
+    int_t          e5;          ///< Search thread count
     union  ed_flag ed;          ///< Edit level flags
     int_t          ee;          ///< ESCape surrogate
     union  eh_flag eh;          ///< Help message flags
@@ -114,6 +114,7 @@ enum errcodes
     E_SNI,          ///< Semi-colon not in iteration
     E_SRH,          ///< Search failure: 'foo'
     E_TAG,          ///< Missing tag: '!foo!'
+    E_TMQ,          ///< Too many Q-registers
     E_TXT,          ///< Invalid text delimiter 'x'
     E_UTC,          ///< Unterminated command string
     E_UTM,          ///< Unterminated macro
@@ -109,6 +109,8 @@ extern bool scan_FF(struct cmd *cmd);
 
 extern bool scan_FH(struct cmd *cmd);
 
+extern bool scan_FI(struct cmd *cmd);
+
 extern bool scan_FK(struct cmd *cmd);
 
 extern bool scan_FM(struct cmd *cmd);
@@ -119,6 +121,8 @@ extern bool scan_FR(struct cmd *cmd);
 
 extern bool scan_FS(struct cmd *cmd);
 
+extern bool scan_FW(struct cmd *cmd);
+
 extern bool scan_FZ(struct cmd *cmd);
 
 extern bool scan_F_under(struct cmd *cmd);
@@ -260,6 +264,8 @@ extern void exec_E3(struct cmd *cmd);
 
 extern void exec_E4(struct cmd *cmd);
 
+extern void exec_E5(struct cmd *cmd);
+
 extern void exec_EA(struct cmd *cmd);
 
 extern void exec_EB(struct cmd *cmd);
@@ -330,6 +336,8 @@ extern void exec_FD(struct cmd *cmd);
 
 extern void exec_FF(struct cmd *cmd);
 
+extern void exec_FI(struct cmd *cmd);
+
 extern void exec_FK(struct cmd *cmd);
 
 extern void exec_FL(struct cmd *cmd);
@@ -346,6 +354,8 @@ extern void exec_FS(struct cmd *cmd);
 
 extern void exec_FU(struct cmd *cmd);
 
+extern void exec_FW(struct cmd *cmd);
+
 extern void exec_F_else(struct cmd *cmd);
 
 extern void exec_F_endif(struct cmd *cmd);
@@ -69,16 +69,22 @@ extern char last_file[];
 
 // File functions
 
+extern bool check_input(uint_t *nbytes);
+
 extern void close_input(uint stream);
 
 extern void close_output(uint stream);
 
+extern void copy_input(struct ifile *ifile, FILE *fp);
+
 extern struct ifile *find_command(const char *name, uint stream, bool colon);
 
 extern int get_wild(void);
 
 extern char *init_filename(const char *src, uint_t len, bool colon);
 
+extern uchar *map_input(struct ifile *ifile, uint_t *nbytes);
+
 extern struct ifile *open_command(const char *name, uint stream, bool colon, uint_t *size);
 
 extern struct ifile *open_input(const char *name, uint stream, bool colon);
@@ -90,6 +96,9 @@ extern FILE *open_temp(const char *oname, uint stream);
 
 extern void read_command(struct ifile *ifile, uint stream, tbuffer *text);
 
+extern bool read_input(struct ifile *ifile, uchar *buf, uint_t *nbytes,
+                       bool single);
+
 extern bool read_memory(char *p, uint len);
 
 extern void rename_output(struct ofile *ofile);
@@ -98,6 +107,11 @@ extern void set_last(const char *name);
 
 extern bool set_wild(const char *filename);
 
+extern void unmap_input(void);
+
 extern void write_memory(const char *file);
 
+extern int write_text(FILE *fp, const char *text, uint_t nbytes, bool CR_out,
+                      int last);
+
 #endif  // !defined(_FILE_H)
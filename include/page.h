@@ -39,6 +39,8 @@ extern void page_flush(FILE *fp);
 
 extern bool page_forward(FILE *fp, int_t start, int_t end, bool ff);
 
+extern void page_skip(FILE *fp, const char *text, uint_t nbytes, bool ff);
+
 extern void reset_pages(uint stream);
 
 extern void set_page(uint page);
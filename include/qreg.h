@@ -55,6 +55,8 @@ struct qreg
 
 extern void append_qchr(int qindex, int c);
 
+extern void append_qtext(int qindex, const char *text, uint_t nbytes);
+
 extern void delete_qtext(int qindex);
 
 extern uint_t get_qall(void);
@@ -30,6 +30,15 @@
 #include <stdbool.h>
 
 
+/// @def    fold_ngram(c)
+/// @brief  Fold character for search index, so that characters that differ
+///         only in case (as defined by CTRL/X) have the same trigrams.
+
+#define fold_ngram(c) ((c) >= '`' && (c) <= '~' ? (c) - ('a' - 'A') : (c))
+
+#define NGRAM_KEY   0xFFFFFFu       ///< Mask for trigram in search index
+
+
 ///  @enum   search_type
 ///  @brief  Type of search requested.
 
@@ -53,8 +62,7 @@ struct search
     int_t text_start;                   ///< Start search at this position
     int_t text_end;                     ///< End search at this position
     int_t text_pos;                     ///< Position of string relative to dot
-    uint_t match_len;                   ///< No. of characters left to match
-    const char *match_buf;              ///< Next character to match
+    int_t match_start;                  ///< Start of string relative to dot
 };
 
 // Global variables
@@ -65,6 +73,14 @@ extern tstring last_search;
 
 extern void build_search(const char *src, uint_t len);
 
+extern uint_t count_search(struct search *s);
+
+extern const uint_t *find_ngrams(uint key, uint_t *count);
+
+extern uint_t replace_all(struct search *s, const char *text, uint_t len);
+
+extern void reset_ngrams(void);
+
 extern bool search_loop(struct search *s);
 
 extern bool search_backward(struct search *s);
@@ -136,6 +136,7 @@ struct tbuffer
     uint_t size;                        ///< Total size of buffer in bytes
     uint_t len;                         ///< Current length stored
     uint_t pos;                         ///< Position of next character
+    struct cmd_cache *cache;            ///< Cached scan data (for macros)
 };
 
 typedef struct tbuffer tbuffer;         ///< TECO buffer
@@ -212,6 +213,10 @@ struct ifile
     char *name;                     ///< Input file name
     uint_t size;                    ///< Input file size
     bool LF;                        ///< First LF has been read
+    bool eof;                       ///< End of file has been read
+    uchar *buf;                     ///< Input block (read-ahead)
+    uint_t pos;                     ///< Position of next byte in block
+    uint_t len;                     ///< No. of bytes in block
 };
 
 ///  @struct  ofile
@@ -248,6 +253,8 @@ extern const char *teco_vtedit;
 
 // General-purpose common functions
 
+extern void add_mem(void *p1, uint_t size);
+
 extern void *alloc_mem(uint_t size);
 
 extern tbuffer alloc_tbuf(uint_t size);
@@ -260,6 +267,8 @@ extern bool check_loop(void);
 
 extern bool check_macro(void);
 
+extern void delete_mem(void *p1);
+
 extern void detach_term(void);
 
 extern void exit_cbuf(void);
@@ -298,7 +307,7 @@ extern void reset_map(void);
 
 extern void *shrink_mem(void *p1, uint_t size, uint_t delta);
 
-extern int teco_env(int n, bool colon);
+extern int_t teco_env(int n, bool colon);
 
 extern int tprint(const char *format, ...);
 
@@ -64,7 +64,7 @@ bool append(bool n_set, int_t n_arg, bool colon)
 
     set_dot(t->Z);                      // Go to end of buffer
 
-    if (feof(ifile->fp))                // Already at EOF?
+    if (ifile->eof)                     // Already at EOF?
     {
         return false;
     }
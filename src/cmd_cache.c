@@ -0,0 +1,289 @@
+///
+///  @file    cmd_cache.c
+///  @brief   Functions to cache scan data for macros.
+///
+///  @copyright 2019-2023 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "teco.h"
+#include "cmdbuf.h"
+#include "eflags.h"
+
+
+#define CACHE_BITS  4               ///< Initial no. of bits in slot no.
+
+///  @struct  jump_slot
+///  @brief   Hash table entry for a saved skip.
+
+struct jump_slot
+{
+    uint_t key;                     ///< Position + 1 (0 if slot is empty)
+    struct jump jump;               ///< Saved skip
+};
+
+///  @struct  text_slot
+///  @brief   Hash table entry for a scanned text argument.
+
+struct text_slot
+{
+    uint_t key;                     ///< Position + 1 (0 if slot is empty)
+    struct text_scan scan;          ///< Saved scan
+};
+
+
+// Local functions
+
+static void *find_slot(struct cache_table *table, uint_t pos, uint_t size);
+
+static void grow_table(struct cache_table *table, uint_t size);
+
+static uint_t hash_pos(const struct cache_table *table, uint_t key);
+
+
+///
+///  @brief    Find the entry for a position in a hash table, adding an empty
+///            entry if there isn't one. The table is allocated when it is
+///            first needed, and doubled in size when it is three-quarters
+///            full. Since that moves the entries, a pointer to an entry is
+///            only valid until the next call for the same table.
+///
+///  @returns  Pointer to entry (starting with its key).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void *find_slot(struct cache_table *table, uint_t pos, uint_t size)
+{
+    assert(table != NULL);
+
+    if (table->slots == NULL)
+    {
+        table->bits  = CACHE_BITS;
+        table->size  = 1u << table->bits;
+        table->count = 0;
+        table->slots = alloc_mem(table->size * size);
+    }
+    else if (table->count >= table->size / 4 * 3)
+    {
+        grow_table(table, size);
+    }
+
+    uint_t key = pos + 1;
+    uint_t i = hash_pos(table, key);
+
+    for (;;)                            // Linear probing
+    {
+        uint_t *slot = (void *)((uchar *)table->slots + i * size);
+
+        if (*slot == key)
+        {
+            return slot;
+        }
+        else if (*slot == 0)
+        {
+            *slot = key;
+            ++table->count;
+
+            return slot;
+        }
+
+        i = (i + 1) & (table->size - 1);
+    }
+}
+
+
+///
+///  @brief    Release reference to cache, and free it if it is no longer in
+///            use. This is called whenever a Q-register's text changes, and
+///            when a macro using the cache returns.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void free_cache(struct cmd_cache **cache)
+{
+    assert(cache != NULL);
+
+    struct cmd_cache *p = *cache;
+
+    if (p != NULL)
+    {
+        *cache = NULL;
+
+        assert(p->refs != 0);
+
+        if (--p->refs == 0)
+        {
+            free_mem(&p->text.slots);
+            free_mem(&p->jump.slots);
+            free_tags(&p->tags);
+            free_mem(&p);
+        }
+    }
+}
+
+
+///
+///  @brief    Get cached data for skip that starts at a specified position in
+///            a command string. Since what gets skipped depends on the E1 and
+///            E2 flags, all saved skips are discarded if those have changed.
+///
+///  @returns  Pointer to data, or NULL if position is out of range.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+struct jump *get_jump(struct cmd_cache *cache, uint_t pos)
+{
+    assert(cache != NULL);
+
+    if (pos >= cache->len)
+    {
+        return NULL;
+    }
+
+    struct cache_table *table = &cache->jump;
+
+    if (table->slots != NULL
+        && (cache->e1 != f.e1.flag || cache->e2 != f.e2.flag))
+    {
+        memset(table->slots, 0, table->size * sizeof(struct jump_slot));
+
+        table->count = 0;
+    }
+
+    cache->e1 = f.e1.flag;
+    cache->e2 = f.e2.flag;
+
+    struct jump_slot *slot = find_slot(table, pos,
+                                       (uint_t)sizeof(struct jump_slot));
+
+    return &slot->jump;
+}
+
+
+///
+///  @brief    Get cached data for text argument that starts at a specified
+///            position in a command string.
+///
+///  @returns  Pointer to data, or NULL if position is out of range.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+struct text_scan *get_text(struct cmd_cache *cache, uint_t pos)
+{
+    assert(cache != NULL);
+
+    if (pos >= cache->len)
+    {
+        return NULL;
+    }
+
+    struct text_slot *slot = find_slot(&cache->text, pos,
+                                       (uint_t)sizeof(struct text_slot));
+
+    return &slot->scan;
+}
+
+
+///
+///  @brief    Double the size of a hash table, and move its entries.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void grow_table(struct cache_table *table, uint_t size)
+{
+    assert(table != NULL);
+
+    uchar *old = table->slots;
+    uint_t nslots = table->size;
+
+    ++table->bits;
+
+    table->size  = 1u << table->bits;
+    table->slots = alloc_mem(table->size * size);
+
+    for (uint_t i = 0; i < nslots; ++i)
+    {
+        const uint_t *slot = (const void *)(old + i * size);
+
+        if (*slot != 0)
+        {
+            uint_t j = hash_pos(table, *slot);
+
+            while (*(uint_t *)(void *)((uchar *)table->slots + j * size) != 0)
+            {
+                j = (j + 1) & (table->size - 1);
+            }
+
+            memcpy((uchar *)table->slots + j * size, slot, (size_t)size);
+        }
+    }
+
+    free_mem(&old);
+}
+
+
+///
+///  @brief    Get slot no. for a key, using Fibonacci hashing so that nearby
+///            positions are spread through the table.
+///
+///  @returns  Slot no.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t hash_pos(const struct cache_table *table, uint_t key)
+{
+    return (uint_t)((uint32_t)((uint32_t)key * 2654435761u)
+                    >> (32 - table->bits));
+}
+
+
+///
+///  @brief    Create new cache for command string.
+///
+///  @returns  Pointer to cache (with one reference).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+struct cmd_cache *new_cache(uint_t len)
+{
+    struct cmd_cache *cache = alloc_mem((uint_t)sizeof(*cache));
+
+    cache->refs = 1;
+    cache->len  = len;
+    cache->tags = NULL;
+    cache->e1   = 0;
+    cache->e2   = 0;
+
+    cache->text = (struct cache_table){ .slots = NULL, .size = 0 };
+    cache->jump = (struct cache_table){ .slots = NULL, .size = 0 };
+
+    return cache;
+}
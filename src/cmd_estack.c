@@ -160,6 +160,8 @@ struct xstack
 
 static struct xstack *x = NULL;     ///< List of expression stacks
 
+static struct xstack *x_free = NULL; ///< List of unused expression stacks
+
 
 // Local functions
 
@@ -200,7 +202,8 @@ void delete_x(void)
 
         x = ptr->next;
 
-        free_mem(&ptr);
+        ptr->next = x_free;             // Save stack for reuse
+        x_free = ptr;
     }
 }
 
@@ -377,6 +380,15 @@ void exit_x(void)
 
         free_mem(&x);                   // Now delete root stack
     }
+
+    while (x_free != NULL)              // Free stacks saved for reuse
+    {
+        struct xstack *next = x_free->next;
+
+        free_mem(&x_free);
+
+        x_free = next;
+    }
 }
 
 
@@ -448,13 +460,9 @@ void init_x(void)
     }
     else
     {
-        struct xstack *next;
-
-        while ((next = x->next) != NULL)
+        while (x->next != NULL)
         {
-            free_mem(&x);
-
-            x = next;
+            delete_x();
         }
 
         reset_x();
@@ -471,7 +479,16 @@ void init_x(void)
 
 void new_x(void)
 {
-    struct xstack *p = alloc_mem((uint_t)sizeof(*p));
+    struct xstack *p = x_free;
+
+    if (p != NULL)                      // Reuse stack if we can
+    {
+        x_free = p->next;
+    }
+    else
+    {
+        p = alloc_mem((uint_t)sizeof(*p));
+    }
 
     p->next = x;
     x = p;
@@ -95,6 +95,9 @@ uint_t cmd_line;                    ///< Line number in current command/macro
 
 // Local functions
 
+static void find_text(int delim, const char *start, uint_t nbytes,
+                      struct text_scan *token);
+
 static INLINE void scan_cmd(struct cmd *cmd);
 
 static INLINE const struct cmd_table *scan_special(struct cmd *cmd);
@@ -263,6 +266,67 @@ void exec_str(const char *str)
 }
 
 
+///
+///  @brief    Find the end of a text string, and count the LFs in it.
+///
+///  @returns  Nothing (results are stored in token).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void find_text(int delim, const char *start, uint_t nbytes,
+                      struct text_scan *token)
+{
+    assert(start != NULL);
+    assert(token != NULL);
+
+    const char *end = memchr(start, delim, (size_t)nbytes);
+
+    token->lines = 0;
+    token->tail  = true;
+
+    if (end != NULL)
+    {
+        token->len = (uint_t)(end - start);
+
+        const char *p = start;
+
+        for (uint i = 0; i < token->len; ++i)
+        {
+            if (*p++ == LF)
+            {
+                ++token->lines;
+            }
+        }
+
+        if (delim == LF)                // Is LF the delimiter (for !! tags)?
+        {
+            ++token->lines;             // Yes, so count that also
+        }
+    }
+    else if (delim == LF)               // Processing a one-line comment?
+    {
+        end = memchr(start, ESC, (size_t)nbytes);
+
+        if (end != NULL)                // Did we find an ESCape?
+        {
+            token->len = (uint_t)(end - start);
+        }
+        else                            // No, just consume remainder of line
+        {
+            token->len = nbytes;
+        }
+
+        token->tail = false;            // No closing delimiter
+    }
+    else
+    {
+        throw(E_BALK);                  // Unexpected end of command or macro
+    }
+
+    token->delim = (char)delim;
+}
+
+
 ///
 ///  @brief    Scan command and see if we're finished with it.
 ///
@@ -485,6 +549,10 @@ static INLINE const struct cmd_table *scan_special(struct cmd *cmd)
 ///            which is usually, but not always, the same as the opening
 ///            delimiter.
 ///
+///            If the command string is a macro, then the result is saved in
+///            its cache, so that we need not scan the text again if a loop or
+///            a branch brings us back to it.
+///
 ///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
@@ -495,53 +563,34 @@ static void scan_text(int delim, tstring *text)
 
     text->data = cbuf->data + cbuf->pos;
 
-    size_t nbytes = cbuf->len - cbuf->pos;
-    const char *start = text->data;
-    const char *end = memchr(start, delim, (size_t)nbytes);
-    uint_t len, tail = 1;
+    struct text_scan scan;
+    struct text_scan *token = NULL;
+    uint_t nbytes = cbuf->len - cbuf->pos;
 
-    if (end != NULL)
+    if (cbuf->cache != NULL && delim != NUL)
     {
-        len = (uint)(end - start);
-
-        // If we're counting lines, then count any LFs in the text string.
-
-        if (cmd_line != 0)
-        {
-            const char *p = start;
+        token = get_text(cbuf->cache, cbuf->pos);
+    }
 
-            for (uint i = 0; i < len; ++i)
-            {
-                if (*p++ == LF)
-                {
-                    ++cmd_line;
-                }
-            }
+    if (token == NULL)                  // Not in a macro, so just scan text
+    {
+        token = &scan;
 
-            if (delim == LF)            // Is LF the delimiter (for !! tags)?
-            {
-                ++cmd_line;             // Yes, so count that also
-            }
-        }
+        find_text(delim, text->data, nbytes, token);
     }
-    else if (delim == LF)               // Processing a one-line comment?
+    else if (token->delim != (char)delim) // First time we've seen text?
     {
-        end = memchr(start, ESC, (size_t)nbytes);
+        find_text(delim, text->data, nbytes, token);
+    }
 
-        if (end != NULL)                // Did we find an ESCape?
-        {
-            len = (uint)(end - start);
-        }
-        else                            // No, just consume remainder of line
-        {
-            len = (uint)nbytes;
-        }
+    uint_t len  = token->len;
+    uint_t tail = token->tail ? 1 : 0;
 
-        tail = 0;                       // No closing delimiter
-    }
-    else
+    // If we're counting lines, then count any LFs in the text string.
+
+    if (cmd_line != 0)
     {
-        throw(E_BALK);                  // Unexpected end of command or macro
+        cmd_line += token->lines;
     }
 
 #if     !defined(NTRACE)
@@ -550,7 +599,7 @@ static void scan_text(int delim, tstring *text)
 
     if (f.trace)
     {
-        const char *p = start;
+        const char *p = text->data;
 
         for (uint i = 0; i < len + tail; ++i)
         {
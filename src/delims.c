@@ -0,0 +1,564 @@
+///
+///  @file    delims.c
+///  @brief   Line delimiter and word counting functions, shared by all edit
+///           buffer handlers.
+///
+///  @copyright 2019-2023 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "teco.h"
+#include "ascii.h"
+#include "editbuf.h"
+
+#if     defined(__SSE2__)
+
+#include <immintrin.h>
+
+#endif
+
+#if     defined(__SSE2__) && defined(__GNUC__) && defined(__x86_64__)
+
+#define DELIM_AVX2                  ///< Check for AVX2 at run time
+
+#endif
+
+#define DELIM_RUN   240             ///< Max. bytes counted per run
+
+/// @def    isspace_ascii(c)
+/// @brief  Check for white space, using the same characters as isspace() in
+///         the C locale.
+
+#define isspace_ascii(c) ((c) == SPACE || (uchar)((c) - HT) <= CR - HT)
+
+
+// Local functions
+
+#if     defined(DELIM_AVX2)
+
+static uint_t count_avx2(const uchar *p, uint_t nbytes);
+
+#endif
+
+static uint_t count_init(const uchar *p, uint_t nbytes);
+
+static uint_t count_scalar(const uchar *p, uint_t nbytes);
+
+#if     defined(__SSE2__)
+
+static uint_t count_sse2(const uchar *p, uint_t nbytes);
+
+#endif
+
+#if     defined(DELIM_AVX2)
+
+static uint_t words_avx2(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                         bool *space);
+
+#endif
+
+static uint_t words_init(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                         bool *space);
+
+static uint_t words_scalar(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                           bool *space);
+
+#if     defined(__SSE2__)
+
+static uint_t words_sse2(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                         bool *space);
+
+#endif
+
+
+///  @var    count_fn
+///  @brief  Function used to count delimiters. This starts out pointing to a
+///          function that checks what the CPU supports, and then replaces
+///          itself with the fastest function available.
+
+static uint_t (*count_fn)(const uchar *p, uint_t nbytes) = count_init;
+
+///  @var    words_fn
+///  @brief  Function used to count words and delimiters, selected in the same
+///          way as count_fn.
+
+static uint_t (*words_fn)(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                          bool *space) = words_init;
+
+
+#if     defined(DELIM_AVX2)
+
+///
+///  @brief    Count the line delimiters in a block of text, using AVX2
+///            instructions to check 32 bytes at a time. This is only called
+///            if the CPU supports AVX2.
+///
+///  @returns  No. of delimiters.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2")))
+static uint_t count_avx2(const uchar *p, uint_t nbytes)
+{
+    const __m256i lf   = _mm256_set1_epi8(LF);
+    const __m256i span = _mm256_set1_epi8(FF - LF);
+    const __m256i zero = _mm256_setzero_si256();
+    uint_t ndelims = 0;
+
+    // A byte is a delimiter if subtracting LF leaves a value no greater than
+    // FF - LF (the same test as count_scalar() uses). Each comparison yields
+    // -1 for a match, which we subtract from a vector of byte counters. Since
+    // a byte counter can't exceed 255, we add up the counters and clear them
+    // after every 255 vectors.
+
+    while (nbytes >= 32)
+    {
+        uint_t nvecs = nbytes / 32;
+
+        if (nvecs > 255)
+        {
+            nvecs = 255;
+        }
+
+        __m256i count = zero;
+
+        for (uint_t i = 0; i < nvecs; ++i)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(const void *)p);
+            __m256i d = _mm256_sub_epi8(v, lf);
+            __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(d, span), d);
+
+            count = _mm256_sub_epi8(count, m);
+            p += 32;
+        }
+
+        __m256i sum = _mm256_sad_epu8(count, zero);
+
+        ndelims += (uint_t)_mm256_extract_epi64(sum, 0);
+        ndelims += (uint_t)_mm256_extract_epi64(sum, 1);
+        ndelims += (uint_t)_mm256_extract_epi64(sum, 2);
+        ndelims += (uint_t)_mm256_extract_epi64(sum, 3);
+        nbytes  -= nvecs * 32;
+    }
+
+    return ndelims + count_scalar(p, nbytes);
+}
+
+#endif
+
+
+///
+///  @brief    Count the line delimiters in a block of text.
+///
+///  @returns  No. of delimiters.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint_t count_delims(const uchar *p, uint_t nbytes)
+{
+    assert(p != NULL || nbytes == 0);
+
+    return (*count_fn)(p, nbytes);
+}
+
+
+///
+///  @brief    Select the function used to count delimiters, based on what the
+///            CPU supports, and then use it to count the delimiters in a block
+///            of text.
+///
+///  @returns  No. of delimiters.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t count_init(const uchar *p, uint_t nbytes)
+{
+#if     defined(DELIM_AVX2)
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        count_fn = count_avx2;
+    }
+    else
+    {
+        count_fn = count_sse2;
+    }
+
+#elif   defined(__SSE2__)
+
+    count_fn = count_sse2;
+
+#else
+
+    count_fn = count_scalar;
+
+#endif
+
+    return (*count_fn)(p, nbytes);
+}
+
+
+///
+///  @brief    Count the line delimiters in a block of text, without using any
+///            instructions specific to a particular CPU. This is also used
+///            for any bytes left over by the vector functions.
+///
+///  @returns  No. of delimiters.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t count_scalar(const uchar *p, uint_t nbytes)
+{
+    uint_t ndelims = 0;
+
+    // Delimiters are counted in runs of no more than DELIM_RUN bytes, using a
+    // byte counter for each run, since this allows the compiler to vectorize
+    // the inner loop much more efficiently than if we used a wider counter.
+    // The run length is a multiple of the vector size, so that the compiler
+    // doesn't need a scalar loop for the leftover bytes of each run.
+
+    while (nbytes != 0)
+    {
+        uint_t n = (nbytes < DELIM_RUN) ? nbytes : DELIM_RUN;
+        uchar count = 0;
+
+        for (uint_t i = 0; i < n; ++i)
+        {
+            count += (uchar)(p[i] - LF) <= FF - LF; // Same as isdelim()
+        }
+
+        ndelims += count;
+        p       += n;
+        nbytes  -= n;
+    }
+
+    return ndelims;
+}
+
+
+#if     defined(__SSE2__)
+
+///
+///  @brief    Count the line delimiters in a block of text, using SSE2
+///            instructions to check 16 bytes at a time. This works the same
+///            way as count_avx2().
+///
+///  @returns  No. of delimiters.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t count_sse2(const uchar *p, uint_t nbytes)
+{
+    const __m128i bias  = _mm_set1_epi8((char)(0x80 - LF));
+    const __m128i limit = _mm_set1_epi8((char)(0x80 + FF - LF + 1));
+    const __m128i zero  = _mm_setzero_si128();
+    __m128i sum = zero;
+
+    // Adding the bias moves LF, VT, and FF to the three smallest signed byte
+    // values, so a single signed comparison finds the delimiters. We check 64
+    // bytes per pass, with a separate vector of byte counters for each 16
+    // bytes so that the additions don't have to wait on each other, and add
+    // the counters to the sum after every 255 passes, before they overflow.
+
+    while (nbytes >= 64)
+    {
+        uint_t npasses = nbytes / 64;
+
+        if (npasses > 255)
+        {
+            npasses = 255;
+        }
+
+        __m128i c0 = zero, c1 = zero, c2 = zero, c3 = zero;
+
+        for (uint_t i = 0; i < npasses; ++i)
+        {
+            const __m128i *v = (const __m128i *)(const void *)p;
+            __m128i v0 = _mm_add_epi8(_mm_loadu_si128(v + 0), bias);
+            __m128i v1 = _mm_add_epi8(_mm_loadu_si128(v + 1), bias);
+            __m128i v2 = _mm_add_epi8(_mm_loadu_si128(v + 2), bias);
+            __m128i v3 = _mm_add_epi8(_mm_loadu_si128(v + 3), bias);
+
+            c0 = _mm_sub_epi8(c0, _mm_cmpgt_epi8(limit, v0));
+            c1 = _mm_sub_epi8(c1, _mm_cmpgt_epi8(limit, v1));
+            c2 = _mm_sub_epi8(c2, _mm_cmpgt_epi8(limit, v2));
+            c3 = _mm_sub_epi8(c3, _mm_cmpgt_epi8(limit, v3));
+            p += 64;
+        }
+
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(c0, zero));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(c1, zero));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(c2, zero));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(c3, zero));
+        nbytes -= npasses * 64;
+    }
+
+    uint_t ndelims = (uint_t)_mm_cvtsi128_si32(sum)
+                   + (uint_t)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+
+    return ndelims + count_scalar(p, nbytes);
+}
+
+#endif
+
+
+///
+///  @brief    Count the words and line delimiters in a block of text. A word
+///            is a run of characters other than white space, and is counted
+///            in the block in which it starts. Blocks must be counted in
+///            order, since the caller keeps track of whether the character
+///            before each block was white space (which is true for the first
+///            block).
+///
+///  @returns  No. of words.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint_t count_words(const uchar *p, uint_t nbytes, uint_t *ndelims, bool *space)
+{
+    assert(p != NULL || nbytes == 0);
+    assert(ndelims != NULL);
+    assert(space != NULL);
+
+    return (*words_fn)(p, nbytes, ndelims, space);
+}
+
+
+#if     defined(DELIM_AVX2)
+
+///
+///  @brief    Count the words and line delimiters in a block of text, using
+///            AVX2 instructions to check 32 bytes at a time. This is only
+///            called if the CPU supports AVX2.
+///
+///  @returns  No. of words.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2")))
+static uint_t words_avx2(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                         bool *space)
+{
+    const __m256i lf    = _mm256_set1_epi8(LF);
+    const __m256i span  = _mm256_set1_epi8(FF - LF);
+    const __m256i ht    = _mm256_set1_epi8(HT);
+    const __m256i wspan = _mm256_set1_epi8(CR - HT);
+    const __m256i sp    = _mm256_set1_epi8(SPACE);
+    const __m256i zero  = _mm256_setzero_si256();
+    __m256i last = *space ? _mm256_set1_epi8(-1) : zero;
+    uint_t nwords = 0;
+
+    // Delimiters are counted as in count_avx2(). A word starts at each byte
+    // that isn't white space, but follows a byte that is, so we compare the
+    // white space mask with a copy shifted by one byte, which includes the
+    // last byte of the previous vector.
+
+    while (nbytes >= 32)
+    {
+        uint_t nvecs = nbytes / 32;
+
+        if (nvecs > 255)
+        {
+            nvecs = 255;
+        }
+
+        __m256i dcount = zero;
+        __m256i wcount = zero;
+
+        for (uint_t i = 0; i < nvecs; ++i)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(const void *)p);
+            __m256i d = _mm256_sub_epi8(v, lf);
+            __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(d, span), d);
+            __m256i w = _mm256_sub_epi8(v, ht);
+            __m256i ws = _mm256_or_si256(
+                _mm256_cmpeq_epi8(_mm256_min_epu8(w, wspan), w),
+                _mm256_cmpeq_epi8(v, sp));
+            __m256i prev = _mm256_alignr_epi8(
+                ws, _mm256_permute2x128_si256(last, ws, 0x21), 15);
+
+            dcount = _mm256_sub_epi8(dcount, m);
+            wcount = _mm256_sub_epi8(wcount, _mm256_andnot_si256(ws, prev));
+            last   = ws;
+            p += 32;
+        }
+
+        __m256i dsum = _mm256_sad_epu8(dcount, zero);
+        __m256i wsum = _mm256_sad_epu8(wcount, zero);
+
+        *ndelims += (uint_t)_mm256_extract_epi64(dsum, 0);
+        *ndelims += (uint_t)_mm256_extract_epi64(dsum, 1);
+        *ndelims += (uint_t)_mm256_extract_epi64(dsum, 2);
+        *ndelims += (uint_t)_mm256_extract_epi64(dsum, 3);
+        nwords   += (uint_t)_mm256_extract_epi64(wsum, 0);
+        nwords   += (uint_t)_mm256_extract_epi64(wsum, 1);
+        nwords   += (uint_t)_mm256_extract_epi64(wsum, 2);
+        nwords   += (uint_t)_mm256_extract_epi64(wsum, 3);
+        nbytes   -= nvecs * 32;
+    }
+
+    *space = (_mm256_movemask_epi8(last) < 0); // Sign bit is last byte
+
+    return nwords + words_scalar(p, nbytes, ndelims, space);
+}
+
+#endif
+
+
+///
+///  @brief    Select the function used to count words and delimiters, based on
+///            what the CPU supports, and then use it to count the words and
+///            delimiters in a block of text.
+///
+///  @returns  No. of words.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t words_init(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                         bool *space)
+{
+#if     defined(DELIM_AVX2)
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        words_fn = words_avx2;
+    }
+    else
+    {
+        words_fn = words_sse2;
+    }
+
+#elif   defined(__SSE2__)
+
+    words_fn = words_sse2;
+
+#else
+
+    words_fn = words_scalar;
+
+#endif
+
+    return (*words_fn)(p, nbytes, ndelims, space);
+}
+
+
+///
+///  @brief    Count the words and line delimiters in a block of text, without
+///            using any instructions specific to a particular CPU. This is also
+///            used for any bytes left over by the vector functions.
+///
+///  @returns  No. of words.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t words_scalar(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                           bool *space)
+{
+    uint_t nwords = 0;
+    bool prev = *space;
+
+    for (uint_t i = 0; i < nbytes; ++i)
+    {
+        uint c = p[i];
+        bool ws = isspace_ascii(c);
+
+        *ndelims += (uchar)(c - LF) <= FF - LF; // Same as isdelim()
+        nwords   += (prev && !ws);
+        prev      = ws;
+    }
+
+    *space = prev;
+
+    return nwords;
+}
+
+
+#if     defined(__SSE2__)
+
+///
+///  @brief    Count the words and line delimiters in a block of text, using
+///            SSE2 instructions to check 16 bytes at a time. This works the
+///            same way as words_avx2().
+///
+///  @returns  No. of words.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t words_sse2(const uchar *p, uint_t nbytes, uint_t *ndelims,
+                         bool *space)
+{
+    const __m128i lf    = _mm_set1_epi8(LF);
+    const __m128i span  = _mm_set1_epi8(FF - LF);
+    const __m128i ht    = _mm_set1_epi8(HT);
+    const __m128i wspan = _mm_set1_epi8(CR - HT);
+    const __m128i sp    = _mm_set1_epi8(SPACE);
+    const __m128i zero  = _mm_setzero_si128();
+    __m128i last = *space ? _mm_set1_epi8(-1) : zero;
+    uint_t nwords = 0;
+
+    while (nbytes >= 16)
+    {
+        uint_t nvecs = nbytes / 16;
+
+        if (nvecs > 255)
+        {
+            nvecs = 255;
+        }
+
+        __m128i dcount = zero;
+        __m128i wcount = zero;
+
+        for (uint_t i = 0; i < nvecs; ++i)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(const void *)p);
+            __m128i d = _mm_sub_epi8(v, lf);
+            __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(d, span), d);
+            __m128i w = _mm_sub_epi8(v, ht);
+            __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(w, wspan), w),
+                                      _mm_cmpeq_epi8(v, sp));
+            __m128i prev = _mm_or_si128(_mm_slli_si128(ws, 1),
+                                        _mm_srli_si128(last, 15));
+
+            dcount = _mm_sub_epi8(dcount, m);
+            wcount = _mm_sub_epi8(wcount, _mm_andnot_si128(ws, prev));
+            last   = ws;
+            p += 16;
+        }
+
+        __m128i dsum = _mm_sad_epu8(dcount, zero);
+        __m128i wsum = _mm_sad_epu8(wcount, zero);
+
+        *ndelims += (uint_t)_mm_cvtsi128_si32(dsum);
+        *ndelims += (uint_t)_mm_cvtsi128_si32(_mm_srli_si128(dsum, 8));
+        nwords   += (uint_t)_mm_cvtsi128_si32(wsum);
+        nwords   += (uint_t)_mm_cvtsi128_si32(_mm_srli_si128(wsum, 8));
+        nbytes   -= nvecs * 16;
+    }
+
+    *space = ((_mm_movemask_epi8(last) & 0x8000) != 0);
+
+    return nwords + words_scalar(p, nbytes, ndelims, space);
+}
+
+#endif
@@ -518,78 +518,87 @@ static void refresh_edit(void)
     int_t pos = len_edit((int_t)-d.ybias);
     int row = -1;
     int col __attribute__((unused));
-    int c;
+    const uchar *text;
+    uint_t nbytes;
+    bool done = false;
 
     wclear(d.edit);
 
     w.topdot = t->dot + pos;            // First character output in window
 
-    while ((c = read_edit(pos)) != EOF)
+    while (!done && (nbytes = span_edit(pos, t->Z - t->dot, &text)) != 0)
     {
-        ++pos;
-
-        getyx(d.edit, row, col);
-
-        chtype ch = (chtype)c;
-
-        if (isprint(c))                 // Printing chr. [32-126]
+        for (uint_t i = 0; i < nbytes; ++i)
         {
-            waddch(d.edit, ch);
-        }
-        else if (iscntrl(c))            // Control chr. [0-31, 127]
-        {
-            switch (c)
-            {
-                case HT:
-                    if (w.seeall)
-                    {
-                        waddstr(d.edit, unctrl(ch));
-                    }
-                    else
-                    {
-                        waddch(d.edit, ch);
-                    }
+            int c = text[i];
 
-                    break;
-
-                case BS:
-                case VT:
-                case FF:
-                case LF:
-                case CR:
-                    if (w.seeall)
-                    {
-                        waddstr(d.edit, unctrl(ch));
-                    }
+            ++pos;
 
-                    break;
+            getyx(d.edit, row, col);
 
-                default:
-                    waddch(d.edit, ch);
+            chtype ch = (chtype)c;
 
-                    break;
+            if (isprint(c))             // Printing chr. [32-126]
+            {
+                waddch(d.edit, ch);
             }
-        }
-        else                            // 8-bit chr. [128-255]
-        {
-            if (w.seeall)
+            else if (iscntrl(c))        // Control chr. [0-31, 127]
             {
-                waddstr(d.edit, table_8bit[c & 0x7f]);
+                switch (c)
+                {
+                    case HT:
+                        if (w.seeall)
+                        {
+                            waddstr(d.edit, unctrl(ch));
+                        }
+                        else
+                        {
+                            waddch(d.edit, ch);
+                        }
+
+                        break;
+
+                    case BS:
+                    case VT:
+                    case FF:
+                    case LF:
+                    case CR:
+                        if (w.seeall)
+                        {
+                            waddstr(d.edit, unctrl(ch));
+                        }
+
+                        break;
+
+                    default:
+                        waddch(d.edit, ch);
+
+                        break;
+                }
             }
-            else
+            else                        // 8-bit chr. [128-255]
             {
-                waddstr(d.edit, unctrl(ch));
+                if (w.seeall)
+                {
+                    waddstr(d.edit, table_8bit[c & 0x7f]);
+                }
+                else
+                {
+                    waddstr(d.edit, unctrl(ch));
+                }
             }
-        }
 
-        if (isdelim(c))                 // Found a delimiter (LF, VT, FF)?
-        {
-            if (row == d.maxrow)        // If at end of last row, then done
+            if (isdelim(c))             // Found a delimiter (LF, VT, FF)?
             {
-                break;
-            }
+                if (row == d.maxrow)    // If at end of last row, then done
+                {
+                    done = true;
 
-            waddch(d.edit, '\n');       // Else output newline
+                    break;
+                }
+
+                waddch(d.edit, '\n');   // Else output newline
+            }
         }
     }
 
@@ -59,12 +59,25 @@ void close_files(void)
     }
     else
     {
-        while (next_page(t->B, t->Z, f.ctrl_e, (bool)true))
+        // Write out the current page, as well as any pages that follow it
+        // because of backward paging, and then copy whatever is left of the
+        // input file without reading it into the edit buffer.
+
+        while (page_forward(ofile->fp, t->B - t->dot, t->Z - t->dot,
+                            f.ctrl_e))
         {
             ;
         }
 
+        kill_edit();
         page_flush(ofile->fp);
+
+        struct ifile *ifile = &ifiles[istream];
+
+        if (ifile->fp != NULL)
+        {
+            copy_input(ifile, ofile->fp);
+        }
     }
 
     set_page(0);
@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>           // for getrusage()
 #include <unistd.h>
 
 #include "teco.h"
@@ -221,6 +222,10 @@ static const char *read_env(const char *name)
 ///                   = 0 - Background process, attached to a terminal.
 ///                   < 0 - Child or detached process.
 ///
+///            -6EJ - Peak resident set size of process, in KB.
+///
+///            -7EJ - Current resident set size of process, in KB.
+///
 ///             0EJ - Process ID
 ///            0:EJ - Parent process ID
 ///
@@ -228,7 +233,7 @@ static const char *read_env(const char *name)
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-int teco_env(int n_arg, bool colon)
+int_t teco_env(int n_arg, bool colon)
 {
     switch (n_arg)
     {
@@ -269,6 +274,47 @@ int teco_env(int n_arg, bool colon)
             }
         }
 
+        case -6:
+        {
+            struct rusage usage;
+
+            if (getrusage(RUSAGE_SELF, &usage) == -1)
+            {
+                return -1;
+            }
+
+#if     defined(__APPLE__)
+
+            return (int_t)(usage.ru_maxrss / KB); // macOS reports bytes
+
+#else
+
+            return (int_t)usage.ru_maxrss;      // Linux reports KB
+
+#endif
+        }
+
+        case -7:
+        {
+            // The second field in statm is the no. of resident pages.
+
+            FILE *fp = fopen("/proc/self/statm", "r");
+            ulong npages;
+            int_t size = -1;
+
+            if (fp != NULL)
+            {
+                if (fscanf(fp, "%*s %lu", &npages) == 1)
+                {
+                    size = (int_t)(npages * (ulong)sysconf(_SC_PAGESIZE) / KB);
+                }
+
+                fclose(fp);
+            }
+
+            return size;
+        }
+
         default:
             throw(E_NYI);               // No such EJ command
     }
@@ -0,0 +1,287 @@
+///
+///  @file    fi_cmd.c
+///  @brief   Execute FI command, and maintain the search index.
+///
+///  @copyright 2019-2023 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "teco.h"
+#include "editbuf.h"
+#include "eflags.h"
+#include "estack.h"
+#include "exec.h"
+#include "search.h"
+
+
+#define NGRAM_MIN_BITS  10              ///< Min. bits in bucket no.
+
+#define NGRAM_MAX_BITS  24              ///< Max. bits in bucket no.
+
+///  @struct  ngrams
+///  @brief   Index of every trigram in the edit buffer. Trigrams are hashed
+///           into buckets, each of which has a sorted list of the positions
+///           at which its trigrams start. Since different trigrams can share
+///           a bucket, a position in the list is only a candidate for a match.
+
+struct ngrams
+{
+    uint_t *first;                      ///< Start of list for each bucket
+    uint_t *pos;                        ///< Positions for all buckets
+    uint_t nbuckets;                    ///< No. of buckets
+    uint bits;                          ///< No. of bits in bucket no.
+    uint_t size;                        ///< Memory used, in bytes
+    uint_t msecs;                       ///< Time taken to build, in msecs.
+};
+
+///   @var    ngrams
+///   @brief  Search index for edit buffer
+
+static struct ngrams ngrams = { .first = NULL, .pos = NULL };
+
+
+// Local functions
+
+static void build_ngrams(void);
+
+static uint_t hash_ngram(uint key);
+
+
+///
+///  @brief    Build the search index for the edit buffer. This makes two passes
+///            over the buffer, the first to count the trigrams in each bucket,
+///            and the second to store their positions.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void build_ngrams(void)
+{
+    clock_t start = clock();
+
+    reset_ngrams();
+
+    // Use about one bucket for every eight positions in the buffer.
+
+    ngrams.bits = NGRAM_MIN_BITS;
+
+    while (ngrams.bits < NGRAM_MAX_BITS
+           && ((uint_t)1 << ngrams.bits) < (uint_t)t->Z / 8)
+    {
+        ++ngrams.bits;
+    }
+
+    // The bucket list is allocated last, since the index isn't used unless
+    // that list exists.
+
+    uint_t npos = (t->Z > 2) ? (uint_t)t->Z - 2 : 0;
+
+    if (npos != 0)
+    {
+        ngrams.pos = alloc_mem(npos * sizeof(uint_t));
+    }
+
+    ngrams.nbuckets = (uint_t)1 << ngrams.bits;
+    ngrams.first    = alloc_mem((ngrams.nbuckets + 1) * sizeof(uint_t));
+    ngrams.size     = (ngrams.nbuckets + 1 + npos) * sizeof(uint_t);
+
+    int_t end = t->Z - t->dot;
+
+    for (int pass = 1; pass <= 2; ++pass)
+    {
+        const uchar *text;
+        uint_t nbytes;
+        uint_t pos = 0;
+        uint key = 0;
+
+        // Trigrams can span the gap in a gap buffer (or the end of a rope
+        // chunk), so we carry the key over from one span to the next.
+
+        while ((nbytes = span_edit((int_t)pos - t->dot, end, &text)) != 0)
+        {
+            for (uint_t i = 0; i < nbytes; ++i, ++pos)
+            {
+                key = ((key << CHAR_BIT) | fold_ngram((uint)text[i]))
+                    & NGRAM_KEY;
+
+                if (pos >= 2)
+                {
+                    uint_t bucket = hash_ngram(key);
+
+                    if (pass == 1)
+                    {
+                        ++ngrams.first[bucket + 1];
+                    }
+                    else
+                    {
+                        ngrams.pos[ngrams.first[bucket]++] = pos - 2;
+                    }
+                }
+            }
+        }
+
+        // After the first pass, each bucket has the no. of positions in the
+        // previous one, which we turn into the start of each list. After the
+        // second pass, each bucket has the start of the next list, so we
+        // shift them all up by one.
+
+        if (pass == 1)
+        {
+            for (uint_t i = 1; i <= ngrams.nbuckets; ++i)
+            {
+                ngrams.first[i] += ngrams.first[i - 1];
+            }
+        }
+        else
+        {
+            for (uint_t i = ngrams.nbuckets; i != 0; --i)
+            {
+                ngrams.first[i] = ngrams.first[i - 1];
+            }
+
+            ngrams.first[0] = 0;
+        }
+    }
+
+    ngrams.msecs = (uint_t)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+}
+
+
+///
+///  @brief    Execute FI command: build or discard the search index.
+///
+///             FI  - Build search index for edit buffer.
+///            0FI  - Discard search index.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exec_FI(struct cmd *cmd)
+{
+    assert(cmd != NULL);
+
+    if (cmd->n_set && cmd->n_arg == 0)
+    {
+        reset_ngrams();
+    }
+    else
+    {
+        build_ngrams();
+    }
+}
+
+
+///
+///  @brief    Find the list of candidate positions for a trigram.
+///
+///  @returns  Sorted list of positions, or NULL if there is no search index.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+const uint_t *find_ngrams(uint key, uint_t *count)
+{
+    assert(count != NULL);
+
+    if (ngrams.first == NULL)
+    {
+        return NULL;
+    }
+
+    uint_t bucket = hash_ngram(key);
+
+    *count = ngrams.first[bucket + 1] - ngrams.first[bucket];
+
+    return ngrams.pos + ngrams.first[bucket];
+}
+
+
+///
+///  @brief    Get bucket no. for trigram.
+///
+///  @returns  Bucket no.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t hash_ngram(uint key)
+{
+    return (uint_t)((uint32_t)(key * 2654435761u) >> (32 - ngrams.bits));
+}
+
+
+///
+///  @brief    Discard the search index. This is called whenever the edit
+///            buffer changes, as well as when we exit.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void reset_ngrams(void)
+{
+    free_mem(&ngrams.first);
+    free_mem(&ngrams.pos);
+
+    ngrams.nbuckets = ngrams.size = ngrams.msecs = 0;
+}
+
+
+///
+///  @brief    Scan FI command.
+///
+///            :FI  - Return memory used by search index, in bytes.
+///          -1:FI  - Return time taken to build search index, in msecs.
+///
+///  @returns  true if command is an operand or operator, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool scan_FI(struct cmd *cmd)
+{
+    assert(cmd != NULL);
+
+    scan_x(cmd);
+    confirm(cmd, NO_M, NO_DCOLON, NO_ATSIGN);
+
+    if (!cmd->colon)                    // FI or nFI
+    {
+        return false;
+    }
+
+    cmd->colon = false;
+
+    if (cmd->n_set && cmd->n_arg == -1) // -1:FI
+    {
+        store_val((int_t)ngrams.msecs);
+    }
+    else                                // :FI
+    {
+        store_val((int_t)ngrams.size);
+    }
+
+    return true;
+}
@@ -28,6 +28,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>                 //lint !e451
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +36,14 @@
 
 #include <sys/stat.h>
 
+#if     defined(__linux__)
+
+#include <signal.h>
+
+#include <sys/mman.h>
+
+#endif
+
 #include "teco.h"
 #include "ascii.h"
 #include "eflags.h"
@@ -43,6 +52,13 @@
 #include "page.h"
 
 
+#define INPUT_BLOCK (64 * KB)           ///< Size of input read-ahead block
+
+#define OUTPUT_BLOCK (16 * KB)          ///< Size of output staging block
+
+#define MAP_MIN     (MB)                ///< Min. size of mapped input file
+
+
 struct ifile ifiles[IFILE_MAX];         ///< Input file descriptors
 
 struct ofile ofiles[OFILE_MAX];         ///< Output file descriptors
@@ -53,10 +69,142 @@ uint ostream = OFILE_PRIMARY;           ///< Current output stream
 
 char last_file[PATH_MAX] = { NUL };     ///< Last opened file
 
+#if     defined(__linux__)
+
+///  @var     mapped
+///
+///  @brief   Input file mapped by map_input(). We keep our own descriptor for
+///           the file, so that we can still check it for changes after the
+///           input stream is closed.
+
+static struct
+{
+    uchar *base;                        ///< Start of mapping (or NULL)
+    size_t len;                         ///< Length of mapping
+    off_t start;                        ///< File offset of mapped text
+    int fd;                             ///< Duplicate file descriptor
+    struct stat stat;                   ///< File status when mapped
+    volatile sig_atomic_t lost;         ///< true if file was truncated
+} mapped =
+{
+    .base  = NULL,
+    .len   = 0,
+    .start = 0,
+    .fd    = -1,
+    .lost  = false,
+};
+
+#endif
+
 // Local functions
 
+#if     defined(__linux__)
+
+static void bus_handler(int sig, siginfo_t *info, void *context);
+
+#endif
+
+static bool fill_input(struct ifile *ifile);
+
 static char *make_canonical(const char *name);
 
+static uint_t scan_input(const uchar *p, uint_t nbytes, uint special);
+
+
+#if     defined(__linux__)
+
+///
+///  @brief    Handle a bus error. If the fault is in the mapped input file,
+///            the file was truncated after it was mapped, so we replace the
+///            rest of the mapping with zeroed memory and note that the text
+///            was lost; check_input() then tells the edit buffer to discard
+///            it. Any other bus error is a bug, so we restore the default
+///            action and let the fault happen again.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void bus_handler(int sig, siginfo_t *info, void *context)
+{
+    (void)context;
+
+    uchar *addr = info->si_addr;
+
+    if (mapped.base != NULL && addr >= mapped.base
+        && addr < mapped.base + mapped.len)
+    {
+        size_t offset = (size_t)(addr - mapped.base);
+
+        offset -= offset % (size_t)sysconf(_SC_PAGESIZE);
+
+        if (mmap(mapped.base + offset, mapped.len - offset,
+                 PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS
+                 | MAP_FIXED, -1, (off_t)0) != MAP_FAILED)
+        {
+            mapped.lost = true;
+
+            return;
+        }
+    }
+
+    (void)signal(sig, SIG_DFL);
+}
+
+#endif
+
+
+///
+///  @brief    Check whether the file mapped by map_input() has changed since
+///            it was mapped, either because it was truncated while we were
+///            reading it, or because its size or modification time differs.
+///
+///  @returns  true if file is unchanged, else false (with nbytes reduced to
+///            the no. of bytes of text still in the file, if that is less).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool check_input(uint_t *nbytes)
+{
+    assert(nbytes != NULL);
+
+#if     defined(__linux__)
+
+    struct stat file_stat;
+
+    if (mapped.base == NULL)
+    {
+        return true;
+    }
+
+    if (fstat(mapped.fd, &file_stat) != 0)
+    {
+        file_stat.st_size = mapped.start;
+    }
+    else if (!mapped.lost
+             && file_stat.st_size == mapped.stat.st_size
+             && file_stat.st_mtim.tv_sec == mapped.stat.st_mtim.tv_sec
+             && file_stat.st_mtim.tv_nsec == mapped.stat.st_mtim.tv_nsec)
+    {
+        return true;
+    }
+
+    off_t size = file_stat.st_size - mapped.start;
+
+    if (size < (off_t)*nbytes)
+    {
+        *nbytes = (size < 0) ? 0 : (uint_t)size;
+    }
+
+    return false;
+
+#else
+
+    return true;
+
+#endif
+}
+
 
 ///
 ///  @brief    Close input file.
@@ -77,6 +225,9 @@ void close_input(uint stream)
     }
 
     free_mem(&ifile->name);
+    free_mem(&ifile->buf);
+
+    ifile->pos = ifile->len = 0;
 }
 
 
@@ -107,6 +258,75 @@ void close_output(uint stream)
 }
 
 
+///
+///  @brief    Copy the rest of an input file to an output file, without using
+///            the edit buffer (used when closing files with EC or EX). Input
+///            blocks that contain nothing which would be translated by
+///            read_input() or write_text() are written out directly; anything
+///            else is read and written a block at a time, just as it would
+///            have been if it had been paged through the edit buffer.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void copy_input(struct ifile *ifile, FILE *fp)
+{
+    assert(ifile != NULL);
+    assert(ifile->fp != NULL);
+    assert(fp != NULL);
+
+    char block[OUTPUT_BLOCK];
+    int last = NUL;
+
+    f.ctrl_e = false;
+
+    while (!ifile->eof)
+    {
+        if (ifile->pos == ifile->len && !fill_input(ifile))
+        {
+            ifile->eof = true;
+
+            break;
+        }
+
+        const uchar *src = ifile->buf + ifile->pos;
+        uint_t avail = ifile->len - ifile->pos;
+
+        // We can copy the block as is if it has no CRs or NULs to convert,
+        // and we're not adding CRs to output or looking for the first LF.
+        // Form feeds need no special handling, since they are written to
+        // the output file whether or not they are page delimiters.
+
+        if (!f.e3.CR_out && (ifile->LF || !f.e3.smart)
+            && memchr(src, CR, (size_t)avail) == NULL
+            && (f.e3.keepNUL || memchr(src, NUL, (size_t)avail) == NULL))
+        {
+            fwrite(src, (size_t)avail, 1uL, fp);
+
+            ifile->pos = ifile->len;
+            last       = src[avail - 1];
+
+            continue;
+        }
+
+        uint_t nbytes = (uint_t)sizeof(block);
+
+        (void)read_input(ifile, (uchar *)block, &nbytes, (bool)false);
+
+        last = write_text(fp, block, nbytes, f.e3.CR_out, last);
+
+        if (f.ctrl_e)                   // Did we reach end of page?
+        {
+            fputc(FF, fp);
+
+            f.ctrl_e = false;
+            last     = FF;
+        }
+    }
+}
+
+
 ///
 ///  @brief    Clean up memory before we exit from TECO.
 ///
@@ -143,6 +363,42 @@ void exit_files(void)
 }
 
 
+///
+///  @brief    Read next block of input file, after moving any unread bytes to
+///            the start of the read-ahead buffer.
+///
+///  @returns  true if any bytes were read, false if at end of file.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool fill_input(struct ifile *ifile)
+{
+    assert(ifile != NULL);
+    assert(ifile->fp != NULL);
+
+    if (ifile->buf == NULL)
+    {
+        ifile->buf = alloc_mem((uint_t)INPUT_BLOCK);
+        ifile->pos = ifile->len = 0;
+    }
+    else if (ifile->pos != 0)
+    {
+        ifile->len -= ifile->pos;
+
+        memmove(ifile->buf, ifile->buf + ifile->pos, (size_t)ifile->len);
+
+        ifile->pos = 0;
+    }
+
+    size_t nbytes = fread(ifile->buf + ifile->len, 1uL,
+                          (size_t)(INPUT_BLOCK - ifile->len), ifile->fp);
+
+    ifile->len += (uint_t)nbytes;
+
+    return (nbytes != 0);
+}
+
+
 ///
 ///  @brief    Create a file name specification in file name buffer. We copy
 ///            from the specified text string, skipping any characters such as
@@ -265,6 +521,152 @@ static char *make_canonical(const char *name)
 }
 
 
+///
+///  @brief    Map the rest of an input file into memory, so that it can be
+///            used as the edit buffer without being copied. This is only done
+///            for large files read by Y or A when no output file is open (so
+///            that the user is just viewing the file), and only if reading the
+///            file with read_input() would leave its contents unchanged. That
+///            means the file can't contain FFs (unless they aren't page
+///            delimiters), CRs, or NULs (unless we're keeping them). The edit
+///            buffer stops using the mapping as soon as the text is changed,
+///            or an output file is opened, or the file changes on disk.
+///
+///  @returns  Start of mapped text (with nbytes set to its length), or NULL if
+///            the file can't be mapped, or is larger than nbytes.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uchar *map_input(struct ifile *ifile, uint_t *nbytes)
+{
+    assert(ifile != NULL);
+    assert(nbytes != NULL);
+
+#if     defined(__linux__)
+
+    struct stat file_stat;
+
+    if (mapped.base != NULL || ifile->fp == NULL || ifile->eof
+        || (ifile != &ifiles[IFILE_PRIMARY]
+            && ifile != &ifiles[IFILE_SECONDARY])
+        || ofiles[OFILE_PRIMARY].fp != NULL
+        || ofiles[OFILE_SECONDARY].fp != NULL
+        || fstat(fileno(ifile->fp), &file_stat) != 0
+        || !S_ISREG(file_stat.st_mode))
+    {
+        return NULL;
+    }
+
+    // Find the next byte that we'd read from the file, allowing for anything
+    // still in the read-ahead block.
+
+    off_t start = ftello(ifile->fp);
+
+    if (start == -1)
+    {
+        return NULL;
+    }
+
+    start -= (off_t)(ifile->len - ifile->pos);
+
+    off_t size = file_stat.st_size - start;
+
+    if (size < MAP_MIN || size > (off_t)*nbytes)
+    {
+        return NULL;
+    }
+
+    off_t base = start - start % sysconf(_SC_PAGESIZE);
+    size_t len = (size_t)(file_stat.st_size - base);
+    uchar *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fileno(ifile->fp), base);
+
+    if (p == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    // If the file is truncated by another process while we're using it, any
+    // access past the new end of file will raise SIGBUS, so we catch that.
+
+    static bool handler = false;
+
+    if (!handler)
+    {
+        struct sigaction sa;
+
+        sa.sa_sigaction = bus_handler;
+        sa.sa_flags = SA_SIGINFO;
+
+        sigemptyset(&sa.sa_mask);
+
+        if (sigaction(SIGBUS, &sa, NULL) == 0)
+        {
+            handler = true;
+        }
+    }
+
+    if (!handler || (mapped.fd = dup(fileno(ifile->fp))) == -1)
+    {
+        (void)munmap(p, len);
+
+        return NULL;
+    }
+
+    mapped.base  = p;
+    mapped.len   = len;
+    mapped.start = start;
+    mapped.stat  = file_stat;
+    mapped.lost  = false;
+
+    uchar *text = p + (start - base);
+
+    // Each special character is checked for separately, since memchr() is
+    // much faster than scan_input() for text with lots of short lines. We
+    // check for FF first, since if the file has multiple pages, that lets us
+    // give up at the end of the current page, instead of scanning the rest of
+    // the file each time a page is read.
+
+    if ((!f.e3.nopage && memchr(text, FF, (size_t)size) != NULL)
+        || memchr(text, CR, (size_t)size) != NULL
+        || (!f.e3.keepNUL && memchr(text, NUL, (size_t)size) != NULL)
+        || mapped.lost)
+    {
+        unmap_input();
+
+        return NULL;
+    }
+
+    if (!ifile->LF && memchr(text, LF, (size_t)size) != NULL)
+    {
+        ifile->LF = true;               // Same as for first LF in read_input()
+
+        if (f.e3.smart)
+        {
+            f.e3.CR_in  = false;
+            f.e3.CR_out = false;
+        }
+    }
+
+    // Skip over the text, just as though we had read it.
+
+    (void)fseeko(ifile->fp, (off_t)0, SEEK_END);
+
+    ifile->pos = ifile->len = 0;
+    ifile->eof = true;
+
+    *nbytes = (uint_t)size;
+
+    return text;
+
+#else
+
+    return NULL;
+
+#endif
+}
+
+
 ///
 ///  @brief    Open indirect command file which may have an implicit .tec file
 ///            type/extension. We try to open the file as specified, but if
@@ -366,6 +768,9 @@ struct ifile *open_input(const char *name, uint stream, bool colon)
     ifile->name = alloc_mem((uint_t)strlen(name) + 1);
     ifile->size = (uint_t)file_stat.st_size;
     ifile->LF   = false;                // No LF characters read yet
+    ifile->eof  = false;
+    ifile->pos  = 0;
+    ifile->len  = 0;
 
     strcpy(ifile->name, name);
 
@@ -513,6 +918,234 @@ void read_command(struct ifile *ifile, uint stream, tbuffer *text)
 }
 
 
+///
+///  @brief    Read text from input file. Input is read in large blocks, and
+///            runs of bytes that need no special handling are copied straight
+///            to the caller's buffer. We only need to look at CR, FF, and NUL
+///            characters, LF until we've seen the first one (for smart mode),
+///            and all line delimiters when reading a single line.
+///
+///            We stop reading when the caller's buffer is full, at the end of
+///            the file, at a FF (unless FFs aren't page delimiters), or after
+///            the first delimiter if we're only reading a single line.
+///
+///  @returns  true if the caller's buffer is full and there may be more text
+///            to read, else false. The no. of bytes stored is returned via the
+///            nbytes argument (which on input contains the buffer size).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool read_input(struct ifile *ifile, uchar *buf, uint_t *nbytes, bool single)
+{
+    assert(ifile != NULL);
+    assert(buf != NULL);
+    assert(nbytes != NULL);
+
+    uchar *p = buf;
+    uchar *end = buf + *nbytes;
+    bool more = false;
+
+    for (;;)
+    {
+        if (ifile->pos == ifile->len && !fill_input(ifile))
+        {
+            ifile->eof = true;
+
+            break;
+        }
+
+        // Set up the characters that need special handling.
+
+        uint special = (1u << CR);
+
+        if (!f.e3.nopage)
+        {
+            special |= (1u << FF);
+        }
+
+        if (!f.e3.keepNUL)
+        {
+            special |= (1u << NUL);
+        }
+
+        if (!ifile->LF)
+        {
+            special |= (1u << LF);
+        }
+
+        if (single)
+        {
+            special |= (1u << LF) | (1u << VT) | (1u << FF);
+        }
+
+        // Copy everything preceding the next special character.
+
+        const uchar *src = ifile->buf + ifile->pos;
+        uint_t avail = ifile->len - ifile->pos;
+        uint_t room = (uint_t)(end - p);
+
+        if (avail > room)
+        {
+            avail = room;
+        }
+
+        uint_t run = scan_input(src, avail, special);
+
+        memcpy(p, src, (size_t)run);
+
+        p          += run;
+        ifile->pos += run;
+
+        if (run == avail)
+        {
+            if (p == end)
+            {
+                more = true;
+
+                break;
+            }
+
+            continue;
+        }
+
+        int c = *(src + run);
+
+        if (c == CR && end - p < 2)     // Make sure there's room for CR/LF
+        {
+            more = true;
+
+            break;
+        }
+
+        ++ifile->pos;
+
+        if (c == LF)
+        {
+            if (!ifile->LF)             // First LF?
+            {
+                ifile->LF = true;
+
+                if (f.e3.smart)         // In smart mode?
+                {
+                    f.e3.CR_in  = false; // Terminate input lines with LF
+                    f.e3.CR_out = false; // Terminate output lines with LF
+                }
+            }
+        }
+        else if (c == CR)               // Check for CR followed by LF
+        {
+            if (ifile->pos == ifile->len) // Need next byte to check for LF
+            {
+                (void)fill_input(ifile);
+            }
+
+            if (ifile->pos < ifile->len && ifile->buf[ifile->pos] == LF)
+            {
+                ++ifile->pos;
+
+                if (!ifile->LF)         // First LF?
+                {
+                    ifile->LF = true;
+
+                    if (f.e3.smart)     // In smart mode?
+                    {
+                        f.e3.CR_in  = true; // Terminate input lines with CR/LF
+                        f.e3.CR_out = true; // Terminate output lines with CR/LF
+                    }
+                }
+            }
+
+            // If input lines can be terminated with CR/LF, then we save
+            // both characters; if they can only be terminated with LF,
+            // then we ignore the CR.
+
+            if (f.e3.CR_in)             // If CR/LF is okay, save CR here
+            {
+                *p++ = (uchar)c;
+            }
+
+            c = LF;                     // Now save the LF
+        }
+        else if (c == FF && !f.e3.nopage)
+        {
+            f.ctrl_e = true;            // Flag FF, but don't store it
+
+            break;
+        }
+        else if (c == NUL && !f.e3.keepNUL)
+        {
+            continue;
+        }
+
+        *p++ = (uchar)c;
+
+        if (single && isdelim(c))       // If just appending single line,
+        {
+            break;                      //  then we're done
+        }
+    }
+
+    *nbytes = (uint_t)(p - buf);
+
+    return more;
+}
+
+
+///
+///  @brief    Scan input for the next character that needs special handling.
+///            All such characters are in the range [NUL, CR], so we first
+///            check eight bytes at a time for anything less than CTRL/N, and only
+///            then look at the individual bytes.
+///
+///  @returns  No. of bytes preceding special character (or nbytes if none).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t scan_input(const uchar *p, uint_t nbytes, uint special)
+{
+    const uint64_t ones  = 0x0101010101010101uLL;
+    const uint64_t highs = 0x8080808080808080uLL;
+    uint_t i = 0;
+
+    for (;;)
+    {
+        for (; i + sizeof(uint64_t) <= nbytes; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+
+            memcpy(&word, p + i, sizeof(word));
+
+            if (((word - ones * CTRL_N) & ~word & highs) != 0)
+            {
+                break;                  // Word has a byte less than CTRL/N
+            }
+        }
+
+        uint_t last = i + sizeof(uint64_t);
+
+        if (last > nbytes)
+        {
+            last = nbytes;
+        }
+
+        for (; i < last; ++i)
+        {
+            int c = p[i];
+
+            if (c < CTRL_N && (special & (1u << c)) != 0)
+            {
+                return i;
+            }
+        }
+
+        if (i == nbytes)
+        {
+            return i;
+        }
+    }
+}
+
+
 ///
 ///  @brief    Save name of last file opened.
 ///
@@ -537,3 +1170,124 @@ void set_last(const char *name)
         }
     }
 }
+
+
+///
+///  @brief    Unmap text that was mapped by map_input().
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void unmap_input(void)
+{
+#if     defined(__linux__)
+
+    if (mapped.base != NULL)
+    {
+        (void)munmap(mapped.base, mapped.len);
+        (void)close(mapped.fd);
+
+        mapped.base = NULL;
+        mapped.fd   = -1;
+    }
+
+#endif
+}
+
+
+///
+///  @brief    Write text to output file, translating LF to CR/LF if needed
+///            (unless the LF is already preceded by a CR). If no translation
+///            is needed, the text is written as is. Otherwise, we find each LF
+///            with memchr(), and copy the text in between to a local block,
+///            which is written out whenever it fills up.
+///
+///  @returns  Last character written (to be passed to the next call).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+int write_text(FILE *fp, const char *text, uint_t nbytes, bool CR_out, int last)
+{
+    assert(fp != NULL);
+
+    if (nbytes == 0)
+    {
+        return last;
+    }
+
+    assert(text != NULL);
+
+    if (!CR_out)
+    {
+        fwrite(text, (size_t)nbytes, 1uL, fp);
+
+        return (uchar)text[nbytes - 1];
+    }
+
+    char block[OUTPUT_BLOCK];
+    uint_t len = 0;
+    const char *end = text + nbytes;
+
+    while (text < end)
+    {
+        const char *lf = memchr(text, LF, (size_t)(end - text));
+        uint_t run = (uint_t)(((lf == NULL) ? end : lf) - text);
+
+        if (run != 0)
+        {
+            last = (uchar)text[run - 1];
+        }
+
+        while (run != 0)                // Copy text preceding LF
+        {
+            uint_t n = OUTPUT_BLOCK - len;
+
+            if (n > run)
+            {
+                n = run;
+            }
+
+            memcpy(block + len, text, (size_t)n);
+
+            len  += n;
+            text += n;
+            run  -= n;
+
+            if (len == OUTPUT_BLOCK)
+            {
+                fwrite(block, (size_t)len, 1uL, fp);
+
+                len = 0;
+            }
+        }
+
+        if (lf == NULL)
+        {
+            break;
+        }
+
+        if (len + 2 > OUTPUT_BLOCK)     // Make sure there's room for CR/LF
+        {
+            fwrite(block, (size_t)len, 1uL, fp);
+
+            len = 0;
+        }
+
+        if (last != CR)
+        {
+            block[len++] = CR;
+        }
+
+        block[len++] = LF;
+        last = LF;
+        ++text;
+    }
+
+    if (len != 0)
+    {
+        fwrite(block, (size_t)len, 1uL, fp);
+    }
+
+    return last;
+}
@@ -257,6 +257,24 @@ void exec_E4(struct cmd *cmd)
 }
 
 
+///
+///  @brief    Execute E5 command: read or set search thread count.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exec_E5(struct cmd *cmd)
+{
+    check_n_flag(cmd, &f.e5);
+
+    if (f.e5 < 0)                       // Negative counts are the same as 0
+    {
+        f.e5 = 0;
+    }
+}
+
+
 ///
 ///  @brief    Execute ED command: read or set mode flags.
 ///
@@ -277,6 +295,7 @@ void exec_ED(struct cmd *cmd)
     f.ed.keepdot  = ed.keepdot;
     f.ed.movedot  = ed.movedot;
     f.ed.nobuffer = ed.nobuffer;
+    f.ed.noshrink = ed.noshrink;
 
     if (f.ed.escape ^ ed.escape)        // Do we need to update display?
     {
@@ -473,9 +492,7 @@ bool scan_EJ(struct cmd *cmd)
         n = (int)cmd->n_arg;            // Get whatever operand we can
     }
 
-    n = teco_env(n, cmd->colon);        // Do the system-dependent part
-
-    store_val((int_t)n);                // Now return the result
+    store_val(teco_env(n, cmd->colon)); // Do the system-dependent part
 
     cmd->colon = false;
 
@@ -514,7 +531,7 @@ bool scan_flag1(struct cmd *cmd)
             confirm(cmd, NO_N);
 
             struct ifile *ifile = &ifiles[istream];
-            int_t eof = (ifile->fp == NULL) ? 0 : feof(ifile->fp) ? -1 : 0;
+            int_t eof = (ifile->fp == NULL) ? 0 : ifile->eof ? -1 : 0;
 
             store_val(eof);
 
@@ -599,6 +616,11 @@ bool scan_flag2(struct cmd *cmd)
 
             return true;
 
+        case '5':                       // E5
+            store_val((int_t)f.e5);
+
+            return true;
+
         case 'D':                       // ED
         case 'd':
             store_val((int_t)f.ed.flag);
@@ -0,0 +1,208 @@
+///
+///  @file    fw_cmd.c
+///  @brief   Execute FW command.
+///
+///  @copyright 2019-2023 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "teco.h"
+#include "ascii.h"
+#include "editbuf.h"
+#include "eflags.h"                 // Needed for confirm()
+#include "errors.h"
+#include "estack.h"
+#include "exec.h"
+#include "qreg.h"
+#include "search.h"
+
+
+#define FW_COUNTS   4               ///< No. of counts returned by FW
+
+
+///
+///  @brief    Execute FW command: count lines, words, characters, and
+///            occurrences of a search string in part of the edit buffer,
+///            and store the counts in the Q-registers listed in the second
+///            text argument, in that order.
+///
+///            m,nFW/text/qregs/ - Count between positions m and n.
+///              nFW/text/qregs/ - Count over n lines.
+///               FW/text/qregs/ - Count over entire buffer (same as HFW).
+///
+///            If colon-modified, the no. of occurrences is also returned.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exec_FW(struct cmd *cmd)
+{
+    assert(cmd != NULL);
+    confirm(cmd, NO_NEG_M);
+
+    int_t m = t->B - t->dot;            // FW => HFW
+    int_t n = t->Z - t->dot;
+
+    if (cmd->m_set)                     // m,nFW
+    {
+        m = cmd->m_arg;
+        n = cmd->n_arg;
+
+        if (m > n)                      // Swap m and n if needed
+        {
+            m ^= n;
+            n ^= m;
+            m ^= n;
+        }
+
+        if (m < t->B || m > t->Z || n < t->B || n > t->Z)
+        {
+            throw(E_POP, "FW");         // Pointer off page
+        }
+
+        // Change absolute positions to relative positions.
+
+        m -= t->dot;
+        n -= t->dot;
+    }
+    else if (cmd->n_set)                // nFW
+    {
+        int_t delta = len_edit(cmd->n_arg);
+
+        if (cmd->n_arg <= 0)
+        {
+            m = delta;
+            n = 0;
+        }
+        else
+        {
+            m = 0;
+            n = delta;
+        }
+    }
+
+    // Check the Q-register names before we do any counting.
+
+    int qindex[FW_COUNTS];
+    uint nregs = 0;
+    const char *p = cmd->text2.data;
+    uint_t len = cmd->text2.len;
+
+    while (len != 0)
+    {
+        bool qlocal = false;
+        int qname = (uchar)*p++;
+
+        --len;
+
+        if (qname == '.')
+        {
+            if (len == 0)
+            {
+                throw(E_MQN);           // Missing Q-register name
+            }
+
+            qlocal = true;
+            qname  = (uchar)*p++;
+
+            --len;
+        }
+
+        int q = get_qindex(qname, qlocal);
+
+        if (q == -1)
+        {
+            throw(E_IQN, qname);        // Invalid Q-register name
+        }
+        else if (nregs == FW_COUNTS)
+        {
+            throw(E_TMQ);               // Too many Q-registers
+        }
+
+        qindex[nregs++] = q;
+    }
+
+    // Count lines and words in a single pass through the text.
+
+    uint_t counts[FW_COUNTS] = { 0 };
+    const uchar *text;
+    uint_t nbytes;
+    bool space = true;
+
+    for (int_t i = m; (nbytes = span_edit(i, n, &text)) != 0;
+         i += (int_t)nbytes)
+    {
+        counts[1] += count_words(text, nbytes, &counts[0], &space);
+    }
+
+    counts[2] = (uint_t)(n - m);
+
+    if (cmd->text1.len != 0)
+    {
+        build_search(cmd->text1.data, cmd->text1.len);
+    }
+
+    if (last_search.len != 0)
+    {
+        struct search s;
+
+        s.type       = SEARCH_S;
+        s.search     = search_forward;
+        s.count      = 1;
+        s.text_start = m;
+        s.text_end   = n;
+
+        counts[3] = count_search(&s);
+    }
+
+    for (uint i = 0; i < nregs; ++i)
+    {
+        store_qnum(qindex[i], (int_t)counts[i]);
+    }
+
+    if (cmd->colon)
+    {
+        store_val((int_t)counts[3]);
+    }
+}
+
+
+///
+///  @brief    Scan FW command.
+///
+///  @returns  false (command is not an operand or operator).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool scan_FW(struct cmd *cmd)
+{
+    assert(cmd != NULL);
+
+    scan_x(cmd);
+    confirm(cmd, NO_DCOLON);
+    scan_texts(cmd, 2, ESC);
+
+    return false;
+}
@@ -24,6 +24,12 @@
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
+#if     defined(__linux__)
+
+#define _GNU_SOURCE                 ///< Needed for mremap()
+
+#endif
+
 #include <assert.h>
 
 #if     !defined(NDEBUG)
@@ -36,18 +42,27 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if     defined(__linux__)
+
+#include <sys/mman.h>
+
+#endif
+
 #include "teco.h"
 #include "ascii.h"
 #include "editbuf.h"
 #include "eflags.h"
+#include "errors.h"
+#include "file.h"
 #include "page.h"
+#include "search.h"
 
 
 #if     !defined(EDIT_MAX)
 
 #if     INT_T == 64
 
-#if     defined(PAGE_VM)
+#if     defined(PAGE_VM) || defined(PAGE_FILE)
 #define EDIT_MAX    (GB * 16)       ///< Maximum size is 16 GB (w/ VM)
 #else
 #define EDIT_MAX    (MB)            ///< Maximum size is 1 MB (w/o VM)
@@ -55,7 +70,7 @@
 
 #elif   INT_T == 32
 
-#if     defined(PAGE_VM)
+#if     defined(PAGE_VM) || defined(PAGE_FILE)
 #define EDIT_MAX    (GB)            ///< Maximum size is 1 GB (w/ VM)
 #else
 #define EDIT_MAX    (MB)            ///< Maximum size is 1 MB (w/o VM)
@@ -77,7 +92,7 @@
 #endif
 
 #if     !defined(EDIT_INIT)
-#if     defined(PAGE_VM)
+#if     defined(PAGE_VM) || defined(PAGE_FILE)
 
 #define EDIT_INIT   (KB * 64)       ///< Initial size is 64 KB
 
@@ -90,6 +105,11 @@
 
 #define EDIT_MIN    (KB)            ///< Minimum size is 1 KB
 
+#define LINE_BLOCK  (KB)            ///< Block size for line index
+#define MOVE_CHUNK  (64 * KB)       ///< Chunk size for moving text
+#define HUGE_PAGE   (2 * MB)        ///< Min. size for using huge pages
+#define SHRINK_MIN  (KB * 256)      ///< Min. size for automatic shrinking
+
 
 ///  @var     eb
 ///
@@ -101,6 +121,10 @@ static struct
     uint_t left;                ///< No. of bytes before gap
     uint_t right;               ///< No. of bytes after gap
     uint_t gap;                 ///< No. of bytes in gap
+    uint_t *index;              ///< Line index (delimiters per block)
+    uint_t *carry;              ///< Pending updates for line index
+    uint_t nblocks;             ///< No. of blocks in line index
+    bool mapped;                ///< true if buffer is mapped input file
     const uint_t min;           ///< Minimum buffer size (fixed)
     const uint_t max;           ///< Maximum buffer size (fixed)
     struct edit t;              ///< Read/write copies of public variables
@@ -112,6 +136,10 @@ static struct
     .left   = 0,
     .right  = 0,
     .gap    = EDIT_INIT,
+    .index  = NULL,
+    .carry  = NULL,
+    .nblocks = 0,
+    .mapped = false,
     .t =
     {
         .size   = EDIT_INIT,
@@ -133,20 +161,90 @@ const struct edit *t = &eb.t;       ///< Read-only pointers to public variables
 
 // Local functions
 
+static uchar *alloc_buf(uint_t size);
+
+static void carry_index(uint_t first, uint_t last);
+
+static uint_t count_lines(uint_t pos);
+
 static void end_insert(uint_t nbytes);
 
+static uint_t find_line(uint_t nlines);
+
+static void free_buf(void);
+
+static void init_index(void);
+
+static bool map_edit(struct ifile *ifile);
+
+static void move_text(uint_t dst, uint_t src, uint_t nbytes);
+
 static int_t next_line(uint_t nlines);
 
 static int_t prev_line(uint_t nlines);
 
 static void reset_edit(void);
 
+static uchar *resize_buf(uint_t size);
+
 static void shift_left(uint_t nbytes);
 
 static void shift_right(uint_t nbytes);
 
+static void shrink_edit(void);
+
 static bool start_insert(uint_t size);
 
+static uint_t sum_index(uint_t block);
+
+static void unmap_edit(void);
+
+static void update_block(uint_t block, uint_t ndelims);
+
+static uint_t update_index(uint_t start, uint_t nbytes, bool add);
+
+
+///
+///  @brief    Allocate memory for edit buffer. On Linux, we map anonymous
+///            memory directly, so that the buffer can later be resized with
+///            mremap() without copying it, and without clearing the new space.
+///
+///  @returns  Pointer to new memory (error if allocation fails).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uchar *alloc_buf(uint_t size)
+{
+#if     defined(__linux__)
+
+    void *p = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (p == MAP_FAILED)
+    {
+        throw(E_MEM);                   // Memory overflow
+    }
+
+#if     defined(MADV_HUGEPAGE)
+
+    if (size >= HUGE_PAGE)
+    {
+        (void)madvise(p, (size_t)size, MADV_HUGEPAGE);
+    }
+
+#endif
+
+    add_mem(p, size);
+
+    return p;
+
+#else
+
+    return alloc_mem(size);
+
+#endif
+}
+
 
 ///
 ///  @brief    Append to edit buffer. Similar to insert_edit(), but adds an
@@ -161,92 +259,78 @@ bool append_edit(struct ifile *ifile, bool single)
 {
     assert(ifile != NULL);
 
-    int c;
-    int next;
-    uchar *p = eb.buf + eb.left;
-    int ndelims = 0;
+    // If the buffer is empty, see if we can use the file as is.
+
+    if (!single && eb.t.Z == 0 && map_edit(ifile))
+    {
+        return !ifile->eof;
+    }
 
-    // Read characters until end of file or end of page
+    // Read directly into the gap until end of file or end of page, expanding
+    // the buffer as needed. We make sure there's always room for a CR/LF.
 
-    while ((c = fgetc(ifile->fp)) != EOF)
+    while (start_insert((uint_t)2))
     {
-        if (c == LF)
+        uint_t nbytes = eb.gap;
+        bool more = read_input(ifile, eb.buf + eb.left, &nbytes, single);
+
+        if (nbytes != 0)
         {
-            if (!ifile->LF)             // First LF?
-            {
-                ifile->LF = true;
+            uint_t ndelims = update_index(eb.left, nbytes, (bool)true);
 
-                if (f.e3.smart)         // In smart mode?
-                {
-                    f.e3.CR_in  = false; // Terminate input lines with LF
-                    f.e3.CR_out = false; // Terminate output lines with LF
-                }
-            }
+            eb.t.nlines += (int)ndelims;
+            eb.t.line   += (int)ndelims;
+
+            end_insert(nbytes);
         }
-        else if (c == CR)               // Check for CR followed by LF
-        {
-            if ((next = fgetc(ifile->fp)) != LF)
-            {
-                ungetc(next, ifile->fp); // Save non-LF for next read
-            }
-            else if (!ifile->LF)        // First LF?
-            {
-                ifile->LF = true;
 
-                if (f.e3.smart)         // In smart mode?
-                {
-                    f.e3.CR_in  = true; // Terminate input lines with CR/LF
-                    f.e3.CR_out = true; // Terminate output lines with CR/LF
-                }
-            }
+        if (!more)
+        {
+            break;
+        }
+    }
 
-            // If input lines can be terminated with CR/LF, then we save
-            // both characters; if they can only be terminated with LF,
-            // then we ignore the CR.
+    return !ifile->eof;
+}
 
-            if (f.e3.CR_in)             // If CR/LF is okay, save CR here
-            {
-                *p++ = (uchar)c;
-            }
 
-            c = LF;                     // Now save the LF
-        }
-        else if (c == FF && !f.e3.nopage)
-        {
-            ++ndelims;
+///
+///  @brief    Apply pending block counts to the line index. Rather than walk
+///            up the tree separately for each block in a range, the counts
+///            are carried up through the range in a single pass, so that only
+///            the nodes that cover blocks outside of the range require a
+///            complete walk up the tree. This matters when shifting the gap,
+///            since that can move a large amount of text.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-            f.ctrl_e = true;            // Flag FF, but don't store it
+static void carry_index(uint_t first, uint_t last)
+{
+    for (uint_t i = first; i <= last; ++i)
+    {
+        uint_t ndelims = eb.carry[i];
 
-            break;
-        }
-        else if (c == NUL && !f.e3.keepNUL)
+        if (ndelims == 0)
         {
             continue;
         }
 
-        *p++ = (uchar)c;
+        eb.carry[i] = 0;
+        eb.index[i] += ndelims;
 
-        if (isdelim(c))
-        {
-            ++ndelims;
+        uint_t next = i + (i & -i);
 
-            if (single)                 // If just appending single line,
-            {
-                break;                  //  then we're done
-            }
+        if (next <= last)
+        {
+            eb.carry[next] += ndelims;
+        }
+        else if (next <= eb.nblocks)
+        {
+            update_block(next - 1, ndelims);
         }
     }
-
-    eb.t.nlines += ndelims;
-
-    uint_t nbytes = (uint_t)(p - (eb.buf + eb.left));
-
-    if (nbytes != 0)
-    {
-        end_insert(nbytes);
-    }
-
-    return (c == EOF) ? false : true;
 }
 
 
@@ -263,6 +347,8 @@ void change_dot(int c)
 {
     assert(isalpha(c));
 
+    unmap_edit();
+
     uint_t i = (uint_t)eb.t.dot;
 
     if (i >= eb.left)
@@ -272,10 +358,103 @@ void change_dot(int c)
 
     eb.buf[i] = eb.t.c = (uchar)c;
 
+    reset_ngrams();                     // Discard any search index
     f.e0.window = true;                 // Window refresh needed
 }
 
 
+///
+///  @brief    Check whether the input file that the edit buffer is mapped to
+///            has changed since we read it. If it has, we copy the buffer to
+///            our own memory, discarding any text that is no longer in the
+///            file. If it hasn't, but an output file has since been opened, we
+///            also copy the buffer, since the mapping is only used when the
+///            user is just viewing the file.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void check_edit(void)
+{
+    if (!eb.mapped)
+    {
+        return;
+    }
+
+    uint_t nbytes = eb.left;            // Mapped text is all before the gap
+
+    if (check_input(&nbytes))
+    {
+        if (ofiles[OFILE_PRIMARY].fp != NULL
+            || ofiles[OFILE_SECONDARY].fp != NULL)
+        {
+            unmap_edit();
+        }
+
+        return;
+    }
+
+    int_t dot = eb.t.dot;
+
+    unmap_edit();                       // Copy text and warn user
+    reset_edit();                       // Keep only what's still in the file
+
+    if (nbytes != 0)
+    {
+        uint_t ndelims = update_index(eb.left, nbytes, (bool)true);
+
+        eb.t.nlines += (int)ndelims;
+        eb.t.line   += (int)ndelims;
+
+        end_insert(nbytes);
+    }
+
+    set_dot(dot < eb.t.Z ? dot : eb.t.Z);
+}
+
+
+///
+///  @brief    Count the line delimiters preceding a position in the buffer,
+///            using the line index for all complete blocks, and then counting
+///            the remaining bytes (excluding any that are in the gap).
+///
+///  @returns  No. of delimiters.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t count_lines(uint_t pos)
+{
+    if (pos >= eb.left)                 // Is position on right side of gap?
+    {
+        pos += eb.gap;                  // Yes, so add bias
+    }
+
+    uint_t block = pos / LINE_BLOCK;
+    uint_t start = block * LINE_BLOCK;
+    uint_t ndelims = sum_index(block);
+
+    if (start < eb.left)
+    {
+        uint_t end = (pos < eb.left) ? pos : eb.left;
+
+        ndelims += count_delims(eb.buf + start, end - start);
+    }
+
+    if (pos > eb.left + eb.gap)
+    {
+        if (start < eb.left + eb.gap)
+        {
+            start = eb.left + eb.gap;
+        }
+
+        ndelims += count_delims(eb.buf + start, pos - start);
+    }
+
+    return ndelims;
+}
+
+
 ///
 ///  @brief    Delete n chars relative to current position.
 ///
@@ -296,6 +475,8 @@ void delete_edit(int_t nbytes)
     }
     else
     {
+        unmap_edit();
+
         // Buffer is: [left][gap][right], with dot somewhere in [left] or
         // [right]. We shift things so that dot ends up immediately preceding
         // [gap]. Then any positive deletion is at the beginning of [right],
@@ -316,71 +497,45 @@ void delete_edit(int_t nbytes)
             nbytes = -nbytes;
 
             assert(nbytes <= eb.t.dot);
+            assert((uint_t)nbytes <= eb.left);
 
-            if (f.e0.display)
-            {
-                int ndelims = 0;
-                uchar *p = eb.buf + eb.left;
-
-                for (int i = 0; i < nbytes; ++i)
-                {
-                    int c = *--p;
-
-                    if (isdelim(c))
-                    {
-                        ++ndelims;
-                    }
-                }
-
-                eb.t.nlines -= ndelims;
-                eb.t.line -= ndelims;
-            }
+            uint_t ndelims = update_index(eb.left - (uint_t)nbytes,
+                                          (uint_t)nbytes, (bool)false);
 
-            assert((uint_t)nbytes <= eb.left);
+            eb.t.nlines -= (int)ndelims;
+            eb.t.line   -= (int)ndelims;
 
             eb.left -= (uint_t)nbytes;
             eb.t.dot -= nbytes;         // Backwards delete affects dot
-
-            eb.t.lastc  = read_edit(-1);
         }
         else                            // Deleting forward in [right]
         {
             assert(nbytes <= eb.t.Z - eb.t.dot);
+            assert((uint_t)nbytes <= eb.right);
 
-            if (f.e0.display)
-            {
-                int ndelims = 0;
-                uchar *p = eb.buf + eb.left + eb.gap;
-
-                for (int i = 0; i < nbytes; ++i)
-                {
-                    int c = *p++;
-
-                    if (isdelim(c))
-                    {
-                        ++ndelims;
-                    }
-                }
-
-                eb.t.nlines -= ndelims;
-            }
+            uint_t ndelims = update_index(eb.left + eb.gap, (uint_t)nbytes,
+                                          (bool)false);
 
-            assert((uint_t)nbytes <= eb.right);
+            eb.t.nlines -= (int)ndelims;
 
             eb.right -= (uint_t)nbytes;
-
-            eb.t.c     = read_edit(0);
-            eb.t.nextc = read_edit(1);
         }
 
         eb.gap += (uint_t)nbytes;       // Increase the gap
         eb.t.Z -= nbytes;               //  and decrease the total
 
+        shrink_edit();
+
+        eb.t.lastc = read_edit(-1);
+        eb.t.c     = read_edit(0);
+        eb.t.nextc = read_edit(1);
+
         int_t prev = prev_line(0);      // Position of start of line
 
         eb.t.pos = eb.t.dot - prev;
         eb.t.len = next_line(1) - prev;
 
+        reset_ngrams();                 // Discard any search index
         f.e0.window = true;             // Window refresh needed
     }
 }
@@ -418,15 +573,15 @@ static void end_insert(uint_t nbytes)
         eb.t.lastc = eb.buf[eb.left - 1];
     }
 
-    eb.t.c = eb.buf[eb.left];
-
-    //eb.t.nextc = ...                  // Next character doesn't change
+    eb.t.c     = read_edit(0);
+    eb.t.nextc = read_edit(1);
 
     if (eb.t.Z != 0 && page_count() == 0)
     {
         set_page(1);
     }
 
+    reset_ngrams();                     // Discard any search index
     f.e0.window = true;                 // Window refresh needed
 }
 
@@ -440,184 +595,563 @@ static void end_insert(uint_t nbytes)
 
 void exit_edit(void)
 {
-    free_mem(&eb.buf);
+    free_buf();
+    free_mem(&eb.index);
+    free_mem(&eb.carry);
 }
 
 
 ///
-///  @brief    Initialize edit buffer. All that we need to do here is allocate
-///            the memory for the buffer, since the rest of the initialization
-///            for the 'eb' and 't' structures is done statically, above.
+///  @brief    Find the position following the nth delimiter in the buffer
+///            (where n is 1 for the first delimiter). The line index is used
+///            to find the block containing the delimiter, and then we scan
+///            that block for it.
 ///
-///  @returns  Nothing.
+///  @returns  Position following delimiter.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-void init_edit(void)
+static uint_t find_line(uint_t n)
 {
-    assert(eb.buf == NULL);             // Double initialization is an error
-
-    eb.buf = alloc_mem(eb.t.size);
-
-    reset_edit();
-}
+    assert(n > 0 && n <= (uint_t)eb.t.nlines);
 
+    // Find the last block for which the sum of the preceding blocks is less
+    // than n. The index is a Fenwick tree, so this takes O(log n) steps.
 
-///
-///  @brief    Insert string in edit buffer.
-///
-///  @returns  true if insert succeeded, else false.
-///
-////////////////////////////////////////////////////////////////////////////////
+    uint_t block = 0;
+    uint_t step = 1;
 
-bool insert_edit(const char *buf, size_t nbytes)
-{
-    assert(buf != NULL);
-    assert(eb.buf != NULL);             // Error if no edit buffer
+    while (step * 2 <= eb.nblocks)
+    {
+        step *= 2;
+    }
 
-    if (!start_insert((uint_t)nbytes))
+    for (; step != 0; step /= 2)
     {
-        return false;
+        if (block + step <= eb.nblocks && eb.index[block + step] < n)
+        {
+            block += step;
+            n -= eb.index[block];
+        }
     }
 
-    memcpy(eb.buf + eb.left, buf, nbytes);
+    assert(block < eb.nblocks);
+
+    uint_t pos = block * LINE_BLOCK;
+    uint_t end = pos + LINE_BLOCK;
 
-    if (f.e0.display)
+    if (end > eb.t.size)                // Last block may be partial
     {
-        int ndelims = 0;
-        const char *p = buf;
+        end = eb.t.size;
+    }
 
-        for (uint i = 0; i < nbytes; ++i)
+    for (; pos < end; ++pos)
+    {
+        if (pos >= eb.left && pos < eb.left + eb.gap) // Skip over gap
         {
-            int c = *p++;
+            pos = eb.left + eb.gap;
 
-            if (isdelim(c))
+            if (pos >= end)
             {
-                ++ndelims;
+                break;
             }
         }
 
-        eb.t.nlines += ndelims;
+        int c = eb.buf[pos];
+
+        if (isdelim(c) && --n == 0)
+        {
+            if (pos >= eb.left)         // Is position on right side of gap?
+            {
+                pos -= eb.gap;          // Yes, so remove bias
+            }
+
+            return pos + 1;
+        }
     }
 
-    end_insert((uint_t)nbytes);
+    // The only way the line index can be wrong is if the buffer is a mapped
+    // input file that was truncated while we were using it, in which case
+    // the missing text reads as NULs until check_edit() discards it.
 
-    return true;                        // Insertion was successful
+    assert(eb.mapped);                  // Line index is corrupted
+
+    return (uint_t)eb.t.Z;
 }
 
 
 ///
-///  @brief    Kill the entire edit buffer.
+///  @brief    Free memory for edit buffer.
 ///
 ///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-void kill_edit(void)
+static void free_buf(void)
 {
-    if (eb.t.Z != 0)                    // Anything in buffer?
+#if     defined(__linux__)
+
+    if (eb.mapped)
     {
-        reset_edit();
+        unmap_input();
 
-        f.e0.window = true;             // Window refresh needed
+        eb.buf = NULL;
+        eb.mapped = false;
     }
-}
-
+    else if (eb.buf != NULL)
+    {
+        delete_mem(eb.buf);
 
-///
-///  @brief    Return number of bytes between dot and nth line terminator.
-///
-///  @returns  Number of characters relative to dot (can be plus or minus).
-///
-////////////////////////////////////////////////////////////////////////////////
+        (void)munmap(eb.buf, (size_t)eb.t.size);
 
-int_t len_edit(int_t n)
-{
-    if (n > 0)
-    {
-        return next_line((uint_t)n) - eb.t.dot;
-    }
-    else
-    {
-        return prev_line((uint_t)-n) - eb.t.dot;
+        eb.buf = NULL;
     }
+
+#else
+
+    free_mem(&eb.buf);
+
+#endif
 }
 
 
 ///
-///  @brief    Move dot to a relative position.
+///  @brief    Initialize edit buffer. All that we need to do here is allocate
+///            the memory for the buffer, since the rest of the initialization
+///            for the 'eb' and 't' structures is done statically, above.
 ///
 ///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-void move_dot(int_t delta)
+void init_edit(void)
+{
+    assert(eb.buf == NULL);             // Double initialization is an error
+
+    eb.buf = alloc_buf(eb.t.size);
+
+    init_index();
+    reset_edit();
+}
+
+
+///
+///  @brief    Initialize line index. This is a Fenwick tree containing the
+///            number of delimiters in each block of the buffer, which allows
+///            us to count or find lines in O(log n) time. Blocks refer to the
+///            physical layout of the buffer, so bytes in the gap are never
+///            counted, and shifting text across the gap only requires that we
+///            update the blocks that the text was moved from and to.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void init_index(void)
+{
+    uint_t nblocks = (eb.t.size + LINE_BLOCK - 1) / LINE_BLOCK;
+
+    if (eb.index != NULL && eb.nblocks != nblocks)
+    {
+        free_mem(&eb.index);
+        free_mem(&eb.carry);
+    }
+
+    if (eb.index == NULL)
+    {
+        eb.index = alloc_mem((nblocks + 1) * (uint_t)sizeof(*eb.index));
+        eb.carry = alloc_mem((nblocks + 1) * (uint_t)sizeof(*eb.carry));
+    }
+    else
+    {
+        memset(eb.index, 0, (size_t)(nblocks + 1) * sizeof(*eb.index));
+    }
+
+    eb.nblocks = nblocks;
+
+    // Count delimiters in each block, and then convert the counts in place
+    // into a Fenwick tree. Note that the tree is indexed starting at 1.
+
+    uint_t start = 0;
+    uint_t end = eb.left;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        for (uint_t pos = start; pos < end; )
+        {
+            uint_t n = LINE_BLOCK - pos % LINE_BLOCK;
+
+            if (n > end - pos)
+            {
+                n = end - pos;
+            }
+
+            eb.index[pos / LINE_BLOCK + 1] += count_delims(eb.buf + pos, n);
+
+            pos += n;
+        }
+
+        start = eb.left + eb.gap;
+        end = eb.t.size;
+    }
+
+    for (uint_t i = 1; i <= nblocks; ++i)
+    {
+        uint_t next = i + (i & -i);
+
+        if (next <= nblocks)
+        {
+            eb.index[next] += eb.index[i];
+        }
+    }
+}
+
+
+///
+///  @brief    Insert string in edit buffer.
+///
+///  @returns  true if insert succeeded, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool insert_edit(const char *buf, size_t nbytes)
+{
+    assert(buf != NULL);
+    assert(eb.buf != NULL);             // Error if no edit buffer
+
+    if (!start_insert((uint_t)nbytes))
+    {
+        return false;
+    }
+
+    memcpy(eb.buf + eb.left, buf, nbytes);
+
+    uint_t ndelims = update_index(eb.left, (uint_t)nbytes, (bool)true);
+
+    eb.t.nlines += (int)ndelims;
+    eb.t.line   += (int)ndelims;
+
+    end_insert((uint_t)nbytes);
+
+    return true;                        // Insertion was successful
+}
+
+
+///
+///  @brief    Kill the entire edit buffer.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void kill_edit(void)
+{
+    if (eb.t.Z != 0)                    // Anything in buffer?
+    {
+        if (eb.mapped)                  // Don't copy text we're discarding
+        {
+            free_buf();
+
+            eb.t.size = EDIT_INIT;
+            eb.buf = alloc_buf(eb.t.size);
+
+            reset_edit();
+            init_index();
+        }
+        else
+        {
+            reset_edit();
+            shrink_edit();
+        }
+
+        reset_ngrams();                 // Discard any search index
+        f.e0.window = true;             // Window refresh needed
+    }
+}
+
+
+///
+///  @brief    Return number of bytes between dot and nth line terminator.
+///
+///  @returns  Number of characters relative to dot (can be plus or minus).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+int_t len_edit(int_t n)
+{
+    if (n > 0)
+    {
+        return next_line((uint_t)n) - eb.t.dot;
+    }
+    else
+    {
+        return prev_line((uint_t)-n) - eb.t.dot;
+    }
+}
+
+
+///
+///  @brief    Use an input file as the edit buffer, if map_input() can map it
+///            into memory. This allows large files to be viewed and searched
+///            without copying them. The mapping is only kept until the text is
+///            first changed, at which point unmap_edit() copies it.
+///
+///  @returns  true if file was mapped, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool map_edit(struct ifile *ifile)
+{
+    uint_t nbytes = eb.max;
+    uchar *text = map_input(ifile, &nbytes);
+
+    if (text == NULL)
+    {
+        return false;
+    }
+
+    free_buf();
+
+    eb.buf    = text;
+    eb.mapped = true;
+    eb.left   = 0;
+    eb.right  = 0;
+    eb.gap    = nbytes;
+    eb.t.size = nbytes;
+
+    init_index();
+
+    // Now treat the text as though we had just read it into the gap.
+
+    uint_t ndelims = update_index(eb.left, nbytes, (bool)true);
+
+    eb.t.nlines += (int)ndelims;
+    eb.t.line   += (int)ndelims;
+
+    end_insert(nbytes);
+
+    return true;
+}
+
+
+///
+///  @brief    Move dot to a relative position.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void move_dot(int_t delta)
 {
     set_dot(eb.t.dot + delta);
 }
 
 
 ///
-///  @brief    Scan forward nlines in edit buffer.
+///  @brief    Move text from one side of the gap to the other. This is done
+///            in chunks, each of which is counted after it is moved (and is
+///            therefore still in the cache), so that the line index can be
+///            updated without making separate passes through the text. Each
+///            chunk is split into pieces that don't cross a block boundary
+///            at either the old or the new location.
 ///
-///  @returns  Position following line terminator (relative to dot).
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void move_text(uint_t dst, uint_t src, uint_t nbytes)
+{
+    if (nbytes == 0)
+    {
+        return;
+    }
+
+    uint_t first = (dst < src ? dst : src) / LINE_BLOCK + 1;
+    uint_t last  = ((dst > src ? dst : src) + nbytes - 1) / LINE_BLOCK + 1;
+
+    while (nbytes != 0)
+    {
+        uint_t chunk = nbytes < MOVE_CHUNK ? nbytes : MOVE_CHUNK;
+
+        if (dst > src)                  // Copy from end if moving up
+        {
+            nbytes -= chunk;
+
+            uint_t from = src + nbytes;
+            uint_t to   = dst + nbytes;
+
+            memmove(eb.buf + to, eb.buf + from, (size_t)chunk);
+
+            for (uint_t n = 0; n < chunk; )
+            {
+                uint_t len = chunk - n;
+                uint_t runt = LINE_BLOCK - (from + n) % LINE_BLOCK;
+
+                if (len > runt)
+                {
+                    len = runt;
+                }
+
+                runt = LINE_BLOCK - (to + n) % LINE_BLOCK;
+
+                if (len > runt)
+                {
+                    len = runt;
+                }
+
+                uint_t ndelims = count_delims(eb.buf + to + n, len);
+
+                eb.carry[(from + n) / LINE_BLOCK + 1] -= ndelims;
+                eb.carry[(to + n) / LINE_BLOCK + 1]   += ndelims;
+
+                n += len;
+            }
+        }
+        else                            // Copy from start if moving down
+        {
+            memmove(eb.buf + dst, eb.buf + src, (size_t)chunk);
+
+            for (uint_t n = 0; n < chunk; )
+            {
+                uint_t len = chunk - n;
+                uint_t runt = LINE_BLOCK - (src + n) % LINE_BLOCK;
+
+                if (len > runt)
+                {
+                    len = runt;
+                }
+
+                runt = LINE_BLOCK - (dst + n) % LINE_BLOCK;
+
+                if (len > runt)
+                {
+                    len = runt;
+                }
+
+                uint_t ndelims = count_delims(eb.buf + dst + n, len);
+
+                eb.carry[(src + n) / LINE_BLOCK + 1] -= ndelims;
+                eb.carry[(dst + n) / LINE_BLOCK + 1] += ndelims;
+
+                n += len;
+            }
+
+            src    += chunk;
+            dst    += chunk;
+            nbytes -= chunk;
+        }
+    }
+
+    carry_index(first, last);
+}
+
+
+///
+///  @brief    Scan forward nlines in edit buffer. Since lines are usually
+///            short, we first look for the end of the current line near dot,
+///            and only use the line index if that fails.
+///
+///  @returns  Absolute position following line terminator.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
 static int_t next_line(uint_t nlines)
 {
-    for (int_t pos = eb.t.dot; pos < eb.t.Z; ++pos)
+    if (nlines == 1)
     {
-        int_t i = pos;
+        int_t end = eb.t.dot + LINE_BLOCK;
 
-        if ((uint_t)pos >= eb.left)     // Is position on right side of gap?
+        if (end > eb.t.Z)
         {
-            i += (int_t)eb.gap;         // Yes, so add bias
+            end = eb.t.Z;
         }
 
-        int c = eb.buf[i];
+        for (int_t pos = eb.t.dot; pos < end; ++pos)
+        {
+            int_t i = pos;
+
+            if ((uint_t)pos >= eb.left) // Is position on right side of gap?
+            {
+                i += (int_t)eb.gap;     // Yes, so add bias
+            }
 
-        if (isdelim(c) && --nlines == 0)
+            int c = eb.buf[i];
+
+            if (isdelim(c))
+            {
+                return ++pos;
+            }
+        }
+
+        if (end == eb.t.Z)
         {
-            return ++pos;
+            return eb.t.Z;
         }
     }
 
-    // There aren't n lines following the current position, so just return Z.
+    uint_t n = (uint_t)eb.t.line + nlines;
+
+    // If there aren't n lines following the current position, return Z.
 
-    return eb.t.Z;
+    if (n > (uint_t)eb.t.nlines)
+    {
+        return eb.t.Z;
+    }
+
+    return (int_t)find_line(n);
 }
 
 
 ///
-///  @brief    Scan backward n lines in edit buffer.
+///  @brief    Scan backward n lines in edit buffer. As with next_line(), we
+///            first look for the start of the current line near dot.
 ///
-///  @returns  Position following line terminator (relative to dot).
+///  @returns  Absolute position following line terminator (or 0 if none).
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
 static int_t prev_line(uint_t nlines)
 {
-    for (int_t pos = eb.t.dot; pos-- > 0; )
+    if (nlines == 0)
     {
-        int_t i = pos;
+        int_t start = eb.t.dot - LINE_BLOCK;
 
-        if ((uint_t)pos >= eb.left)     // Is position on right side of gap?
+        if (start < 0)
         {
-            i += (int_t)eb.gap;         // Yes, so add bias
+            start = 0;
         }
 
-        int c = eb.buf[i];
+        for (int_t pos = eb.t.dot; pos-- > start; )
+        {
+            int_t i = pos;
 
-        if (isdelim(c) && nlines-- == 0)
+            if ((uint_t)pos >= eb.left) // Is position on right side of gap?
+            {
+                i += (int_t)eb.gap;     // Yes, so add bias
+            }
+
+            int c = eb.buf[i];
+
+            if (isdelim(c))
+            {
+                return ++pos;
+            }
+        }
+
+        if (start == 0)
         {
-            return ++pos;
+            return 0;
         }
     }
 
-    // There aren't n lines preceding the current position, so just return B.
+    // If there aren't n lines preceding the current position, return B.
 
-    return 0;
+    if (nlines >= (uint_t)eb.t.line)
+    {
+        return 0;
+    }
+
+    return (int_t)find_line((uint_t)eb.t.line - nlines);
 }
 
 
@@ -659,6 +1193,8 @@ static void reset_edit(void)
     eb.right    = 0;
     eb.gap      = eb.t.size;
 
+    memset(eb.index, 0, (size_t)(eb.nblocks + 1) * sizeof(*eb.index));
+
     eb.t.Z      = 0;
     eb.t.dot    = 0;
     eb.t.nextc  = EOF;
@@ -671,6 +1207,101 @@ static void reset_edit(void)
 }
 
 
+///
+///  @brief    Change size of memory for edit buffer. On Linux, mremap() can
+///            usually do this without copying the buffer, even if the mapping
+///            has to be moved.
+///
+///  @returns  Pointer to resized memory (error if allocation fails).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uchar *resize_buf(uint_t size)
+{
+#if     defined(__linux__)
+
+    void *p = mremap(eb.buf, (size_t)eb.t.size, (size_t)size, MREMAP_MAYMOVE);
+
+    if (p == MAP_FAILED)
+    {
+        throw(E_MEM);                   // Memory overflow
+    }
+
+    delete_mem(eb.buf);
+    add_mem(p, size);
+
+#if     defined(MADV_HUGEPAGE)
+
+    if (size >= HUGE_PAGE)
+    {
+        (void)madvise(p, (size_t)size, MADV_HUGEPAGE);
+    }
+
+#endif
+
+    return p;
+
+#else
+
+    if (size < eb.t.size)
+    {
+        return shrink_mem(eb.buf, eb.t.size, eb.t.size - size);
+    }
+    else
+    {
+        return expand_mem(eb.buf, eb.t.size, size - eb.t.size);
+    }
+
+#endif
+}
+
+
+///
+///  @brief    Get contiguous span of text in edit buffer that ends before the
+///            specified position. Since this stops at the gap, reading a range
+///            that spans the gap takes two calls.
+///
+///  @returns  No. of bytes in span, or 0 if no text in range.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint_t rspan_edit(int_t start, int_t end, const uchar **text)
+{
+    assert(text != NULL);
+
+    start += eb.t.dot;                  // Make relative positions absolute
+    end   += eb.t.dot;
+
+    if (start < 0)
+    {
+        start = 0;
+    }
+
+    if (end > eb.t.Z || start >= end)
+    {
+        return 0;
+    }
+
+    uint_t pos = (uint_t)start;
+
+    if ((uint_t)end > eb.left)          // Does span end on right side of gap?
+    {
+        if (pos < eb.left)              // Yes, so stop at gap
+        {
+            pos = eb.left;
+        }
+
+        *text = eb.buf + pos + eb.gap;
+    }
+    else
+    {
+        *text = eb.buf + pos;
+    }
+
+    return (uint_t)end - pos;
+}
+
+
 ///
 ///  @brief    Move dot to an absolute position.
 ///
@@ -720,7 +1351,7 @@ void set_dot(int_t dot)
     }
     else
     {
-        int delta = dot - eb.t.dot;     // How much are we moving?
+        int_t delta = dot - eb.t.dot;   // How much are we moving?
 
         if (delta == 1)                 // Moving one character forward?
         {
@@ -770,42 +1401,17 @@ void set_dot(int_t dot)
             eb.t.nextc = read_edit(1);
             eb.t.pos   += delta;
 
-            //  If we moved to a new line, recalculate line position and length.
+            //  If we moved to a new line, recalculate line number, position,
+            //  and length.
 
             if (eb.t.pos < 0 || eb.t.pos >= eb.t.len)
             {
+                eb.t.line = (int)count_lines((uint_t)eb.t.dot);
+
                 int_t prev = prev_line(0);
 
                 eb.t.pos = eb.t.dot - prev;
                 eb.t.len = next_line(1) - prev;
-
-                if (f.e0.display)
-                {
-                    if (delta < 0)
-                    {
-                        for (int i = 0; i < -delta; ++i)
-                        {
-                            int c = read_edit(i);
-
-                            if (isdelim(c))
-                            {
-                                --eb.t.line;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        for (int i = -delta; i < 0; ++i)
-                        {
-                            int c = read_edit(i);
-
-                            if (isdelim(c))
-                            {
-                                ++eb.t.line;
-                            }
-                        }
-                    }
-                }
             }
         }
     }
@@ -821,13 +1427,10 @@ void set_dot(int_t dot)
 
 static void shift_left(uint_t nbytes)
 {
-    uchar *src = eb.buf + eb.t.size - eb.right;
-    uchar *dst = eb.buf + eb.left;
+    move_text(eb.left, eb.t.size - eb.right, nbytes);
 
     eb.left  += nbytes;
     eb.right -= nbytes;
-
-    memmove(dst, src, (size_t)nbytes);
 }
 
 
@@ -843,10 +1446,41 @@ static void shift_right(uint_t nbytes)
     eb.left  -= nbytes;
     eb.right += nbytes;
 
-    uchar *src = eb.buf + eb.left;
-    uchar *dst = eb.buf + eb.t.size - eb.right;
+    move_text(eb.t.size - eb.right, eb.left, nbytes);
+}
+
+
+///
+///  @brief    Release memory if the edit buffer is mostly empty, as it may be
+///            after a large deletion (unless the ED&512 flag bit is set). So
+///            that a buffer that is alternately growing and shrinking doesn't
+///            keep being resized, we only shrink it when less than a quarter
+///            of it is in use, and then only to twice the amount in use.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void shrink_edit(void)
+{
+    if (f.ed.noshrink || eb.t.size < SHRINK_MIN)
+    {
+        return;
+    }
+
+    uint_t used = eb.left + eb.right;
+
+    if (used < eb.t.size / 4)
+    {
+        uint_t size = used * 2;
+
+        if (size < EDIT_INIT)
+        {
+            size = EDIT_INIT;
+        }
 
-    memmove(dst, src, (size_t)nbytes);
+        (void)size_edit(size);
+    }
 }
 
 
@@ -882,28 +1516,84 @@ uint_t size_edit(uint_t size)
         return 0;
     }
 
-    // We need to temporarily remove the gap before changing buffer size.
+    unmap_edit();
+
+    // Only the text after the gap needs to be moved, since it has to stay at
+    // the end of the buffer. It's moved before shrinking the buffer, or after
+    // expanding it. The line index is rebuilt afterward, so there's no need
+    // to update it as we go.
 
-    shift_left(eb.right);               // Remove the gap
+    uchar *right = eb.buf + eb.t.size - eb.right;
 
     if (size < eb.t.size)
     {
-        eb.buf = shrink_mem(eb.buf, eb.t.size, eb.t.size - size);
+        memmove(eb.buf + size - eb.right, right, (size_t)eb.right);
+
+        eb.buf = resize_buf(size);
     }
     else
     {
-        eb.buf = expand_mem(eb.buf, eb.t.size, size - eb.t.size);
-    }
+        uint_t offset = (uint_t)(right - eb.buf);
 
-    shift_right(eb.right);              // Restore the gap
+        eb.buf = resize_buf(size);
+
+        memmove(eb.buf + size - eb.right, eb.buf + offset, (size_t)eb.right);
+    }
 
     eb.t.size = size;
     eb.gap = eb.t.size - (eb.left + eb.right);
 
+    init_index();                       // Rebuild index for new size
+
     return size;
 }
 
 
+///
+///  @brief    Get contiguous span of text in edit buffer. Since this stops at
+///            the gap, reading a range that spans the gap takes two calls.
+///
+///  @returns  No. of bytes in span, or 0 if no text in range.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint_t span_edit(int_t start, int_t end, const uchar **text)
+{
+    assert(text != NULL);
+
+    start += eb.t.dot;                  // Make relative positions absolute
+    end   += eb.t.dot;
+
+    if (end > eb.t.Z)
+    {
+        end = eb.t.Z;
+    }
+
+    if (start < 0 || start >= end)
+    {
+        return 0;
+    }
+
+    uint_t pos = (uint_t)start;
+
+    if (pos < eb.left)                  // Is position on left side of gap?
+    {
+        if ((uint_t)end > eb.left)      // Yes, so stop at gap
+        {
+            end = (int_t)eb.left;
+        }
+
+        *text = eb.buf + pos;
+    }
+    else
+    {
+        *text = eb.buf + pos + eb.gap;  // No, so add bias
+    }
+
+    return (uint_t)(end - start);
+}
+
+
 ///
 ///  @brief    Initialize buffer for adding characters.
 ///
@@ -913,18 +1603,37 @@ uint_t size_edit(uint_t size)
 
 static bool start_insert(uint_t nbytes)
 {
-    // Make sure data can fit in the space we have. If not, increase by 50%.
+    unmap_edit();
+
+    // Make sure data can fit in the space we have. If not, increase by 50%,
+    // or by as much as we need if that's more, so that the buffer only has to
+    // be resized once.
 
-    while (eb.gap < nbytes)
+    if (eb.gap < nbytes)
     {
+        uint_t need = eb.left + eb.right + nbytes;
         uint_t size = (eb.t.size * 3) / 2;
 
+        if (need < nbytes)              // Check for overflow
+        {
+            return false;
+        }
+        else if (size < need)
+        {
+            size = need;
+        }
+
         if (size_edit(size) == 0)
         {
             return false;
         }
 
-        print_size(size);
+        print_size(eb.t.size);
+
+        if (eb.gap < nbytes)            // Did we hit the maximum size?
+        {
+            return false;
+        }
     }
 
     // Ensure dot is at start of the gap
@@ -942,3 +1651,131 @@ static bool start_insert(uint_t nbytes)
 
     return true;
 }
+
+
+///
+///  @brief    Get the total no. of delimiters in the blocks preceding a block.
+///
+///  @returns  No. of delimiters.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t sum_index(uint_t block)
+{
+    assert(block <= eb.nblocks);
+
+    uint_t ndelims = 0;
+
+    for (uint_t i = block; i != 0; i -= i & -i)
+    {
+        ndelims += eb.index[i];
+    }
+
+    return ndelims;
+}
+
+
+///
+///  @brief    Copy a mapped input file to our own memory, so that the edit
+///            buffer can be changed. Since nothing has been changed while the
+///            buffer was mapped, the text is all before the gap. If the file
+///            has changed in the meantime, the user is warned that the copy
+///            may not match what was read.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void unmap_edit(void)
+{
+    if (!eb.mapped)
+    {
+        return;
+    }
+
+    assert(eb.right == 0);
+
+    uint_t nbytes = eb.left;
+    bool changed = !check_input(&nbytes);
+    uint_t size = (eb.left + KB - 1) & ~(KB - 1);
+    uchar *buf = alloc_buf(size);
+
+    memcpy(buf, eb.buf, (size_t)eb.left);
+
+    free_buf();
+
+    eb.buf    = buf;
+    eb.gap    = size - eb.left;
+    eb.t.size = size;
+
+    init_index();                       // Rebuild index for new size
+
+    if (changed)
+    {
+        tprint("Input file changed while being read\n");
+    }
+}
+
+
+///
+///  @brief    Add delimiter count for a block to the line index. Note that the
+///            count may be a negative value cast to an unsigned integer.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void update_block(uint_t block, uint_t ndelims)
+{
+    assert(block < eb.nblocks);
+
+    for (uint_t i = block + 1; i <= eb.nblocks; i += i & -i)
+    {
+        eb.index[i] += ndelims;
+    }
+}
+
+
+///
+///  @brief    Update line index for bytes that have been added to, or are
+///            about to be removed from, the text in the buffer. The start is
+///            a physical offset, and the bytes must all be on the same side
+///            of the gap.
+///
+///  @returns  No. of delimiters added or removed.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t update_index(uint_t start, uint_t nbytes, bool add)
+{
+    if (nbytes == 0)
+    {
+        return 0;
+    }
+
+    uint_t first = start / LINE_BLOCK + 1;
+    uint_t last  = (start + nbytes - 1) / LINE_BLOCK + 1;
+    uint_t total = 0;
+
+    for (uint_t i = first; i <= last; ++i)
+    {
+        uint_t n = i * LINE_BLOCK - start;
+
+        if (n > nbytes)
+        {
+            n = nbytes;
+        }
+
+        uint_t ndelims = count_delims(eb.buf + start, n);
+
+        eb.carry[i] += add ? ndelims : -ndelims;
+        total       += ndelims;
+
+        start  += n;
+        nbytes -= n;
+    }
+
+    carry_index(first, last);
+
+    return total;
+}
@@ -38,13 +38,263 @@
 #include "exec.h"
 
 
+#define TAG_MARKS   64              ///< Initial size of mark list
+
+#define TAG_HASH    8               ///< Minimum size of tag hash table
+
+///  @struct  mark
+///  @brief   Command found while scanning a macro for tags that either affects
+///           the loop level or conditional depth, or is an O command or a tag.
+
+struct mark
+{
+    uint_t pos;                     ///< Position following command
+    uint_t line;                    ///< Line number following command
+    uint_t len;                     ///< Length of tag (for tags only)
+    int level;                      ///< Loop level preceding command
+    int depth;                      ///< Conditional depth preceding command
+    char c1;                        ///< Command character
+};
+
+///  @struct  tag
+///  @brief   Hash table entry for tag.
+
+struct tag
+{
+    uint_t mark;                    ///< Index of first mark for tag
+    uint_t count;                   ///< No. of times tag occurs (0 if unused)
+};
+
+///  @struct  tags
+///  @brief   Table of the tags in a macro, built the first time that an O
+///           command is executed in it and kept in the macro's cache. Besides
+///           the tags, this lists all of the loops, conditionals, and O
+///           commands, along with the minimum loop level for any range of
+///           them, so that a jump can be checked without scanning the
+///           commands between the O command and the tag.
+
+struct tags
+{
+    struct mark *mark;              ///< List of marks
+    uint_t nmarks;                  ///< No. of marks in list
+    uint_t size;                    ///< Allocated size of list, in marks
+    int *min;                       ///< Minimum loop levels (sparse table)
+    struct tag *hash;               ///< Hash table for tags
+    uint_t nhash;                   ///< Size of hash table (power of 2)
+    uint_t lines;                   ///< No. of LFs in macro
+    int_t e1;                       ///< E1 flag when table was built
+    int_t e2;                       ///< E2 flag when table was built
+    bool done;                      ///< true if table is complete
+};
+
+
 // Local functions
 
+static void build_tags(const tstring *tag);
+
+static uint_t find_mark(const struct tags *tags, uint_t pos, const char *list);
+
 static void find_tag(const char *text, uint len);
 
+static bool goto_tag(const tstring *tag);
+
+static uint_t hash_tag(const char *text, uint_t len);
+
+static int min_level(const struct tags *tags, uint_t first, uint_t last);
+
 static void validate_tag(tstring *tag);
 
 
+///
+///  @brief    Build tag table for current macro. This is the same scan that
+///            find_tag() does to look for a tag, and it checks the tag we were
+///            asked to find for duplicates in the same way, so that any errors
+///            are reported just as they would be without the table.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void build_tags(const tstring *tag)
+{
+    assert(tag != NULL);
+    assert(cbuf->cache != NULL);
+
+    // The table is attached to the cache before we scan anything, so that it
+    // will be freed if the scan ends with an error.
+
+    free_tags(&cbuf->cache->tags);
+
+    struct tags *tags = alloc_mem((uint_t)sizeof(*tags));
+
+    cbuf->cache->tags = tags;
+
+    tags->size = TAG_MARKS;
+    tags->mark = alloc_mem(tags->size * (uint_t)sizeof(*tags->mark));
+    tags->e1   = f.e1.flag;
+    tags->e2   = f.e2.flag;
+
+    struct cmd cmd;                     // Dummy command block for skip_cmd()
+    uint_t old_pos = cbuf->pos;         // Save command buffer position
+    uint_t old_line = cmd_line;         // Save current line number
+    uint_t ntags = 0;                   // No. of tags found
+    uint nfound = 0;                    // No. of times we found our tag
+    int level = 0;                      // Loop command level
+    int depth = 0;                      // Conditional command depth
+
+    cbuf->pos = 0;
+
+    while (skip_cmd(&cmd, "<>\"'!Oo"))
+    {
+        if (cmd.c1 == '!' && cmd.c2 == '!')
+        {
+            continue;                   // Ignore !! comments
+        }
+
+        if (tags->nmarks == tags->size)
+        {
+            uint_t size = tags->size * (uint_t)sizeof(*tags->mark);
+
+            tags->mark = expand_mem(tags->mark, size, size);
+            tags->size *= 2;
+        }
+
+        struct mark *mark = &tags->mark[tags->nmarks++];
+
+        mark->pos   = cbuf->pos;
+        mark->line  = 1 + cmd_line - old_line;
+        mark->len   = 0;
+        mark->level = level;
+        mark->depth = depth;
+        mark->c1    = cmd.c1;
+
+        switch (cmd.c1)
+        {
+            case '<':                   // Start of loop
+                ++level;
+
+                break;
+
+            case '>':                   // End of loop
+                --level;
+
+                break;
+
+            case '"':                   // 'if' command
+                ++depth;
+
+                break;
+
+            case '\'':                  // 'endif' command
+                --depth;
+
+                break;
+
+            case '!':                   // Tag (label or comment)
+                mark->len = cmd.text1.len;
+
+                ++ntags;
+
+                if (cmd.text1.len == tag->len
+                    && !memcmp(cmd.text1.data, tag->data, (size_t)tag->len)
+                    && nfound++ != 0)
+                {
+                    cmd_line = old_line; // Restore line number for throw()
+
+                    throw(E_DUP, tag->data); // Duplicate tag
+                }
+
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    tags->lines = cmd_line - old_line;
+    cmd_line = old_line;
+    cbuf->pos = old_pos;
+
+    // Enter each tag in the hash table, counting any duplicates.
+
+    tags->nhash = TAG_HASH;
+
+    while (tags->nhash < ntags * 2)
+    {
+        tags->nhash *= 2;
+    }
+
+    tags->hash = alloc_mem(tags->nhash * (uint_t)sizeof(*tags->hash));
+
+    for (uint_t i = 0; i < tags->nmarks; ++i)
+    {
+        const struct mark *mark = &tags->mark[i];
+
+        if (mark->c1 != '!')
+        {
+            continue;
+        }
+
+        const char *text = cbuf->data + mark->pos - 1 - mark->len;
+        uint_t h = hash_tag(text, mark->len) & (tags->nhash - 1);
+        struct tag *entry;
+
+        while ((entry = &tags->hash[h])->count != 0)
+        {
+            const struct mark *first = &tags->mark[entry->mark];
+            const char *name = cbuf->data + first->pos - 1 - first->len;
+
+            if (first->len == mark->len
+                && !memcmp(name, text, (size_t)mark->len))
+            {
+                break;
+            }
+
+            h = (h + 1) & (tags->nhash - 1);
+        }
+
+        if (entry->count++ == 0)
+        {
+            entry->mark = i;
+        }
+    }
+
+    // Row r of the sparse table has the minimum loop level for each run of
+    // 2^r marks, so the minimum for any range is the lesser of two entries.
+
+    uint nrows = 1;
+
+    while (((uint_t)1 << nrows) <= tags->nmarks)
+    {
+        ++nrows;
+    }
+
+    if (tags->nmarks != 0)
+    {
+        tags->min = alloc_mem(nrows * tags->nmarks * (uint_t)sizeof(int));
+
+        for (uint_t i = 0; i < tags->nmarks; ++i)
+        {
+            tags->min[i] = tags->mark[i].level;
+        }
+
+        for (uint r = 1; r < nrows; ++r)
+        {
+            const int *prev = tags->min + (r - 1) * tags->nmarks;
+            int *next = tags->min + r * tags->nmarks;
+            uint_t half = (uint_t)1 << (r - 1);
+
+            for (uint_t i = 0; i + half * 2 <= tags->nmarks; ++i)
+            {
+                next[i] = (prev[i] < prev[i + half]) ? prev[i] : prev[i + half];
+            }
+        }
+    }
+
+    tags->done = true;
+}
+
+
 ///
 ///  @brief    Execute ! command: comment/tag. This function doesn't actually
 ///            do anything, but it exists to ensure that the command is properly
@@ -112,6 +362,46 @@ void exec_O(struct cmd *cmd)
 }
 
 
+///
+///  @brief    Find mark for command that ends at a specified position.
+///
+///  @returns  Index of mark, or the no. of marks if there isn't one for a
+///            command in the list.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t find_mark(const struct tags *tags, uint_t pos, const char *list)
+{
+    assert(tags != NULL);
+    assert(list != NULL);
+
+    uint_t lo = 0;
+    uint_t hi = tags->nmarks;
+
+    while (lo < hi)
+    {
+        uint_t mid = lo + (hi - lo) / 2;
+
+        if (tags->mark[mid].pos < pos)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo == tags->nmarks || tags->mark[lo].pos != pos
+        || strchr(list, tags->mark[lo].c1) == NULL)
+    {
+        return tags->nmarks;
+    }
+
+    return lo;
+}
+
+
 ///
 ///  @brief    Find a specific tag, checking for possible duplicates.
 ///
@@ -135,6 +425,15 @@ static void find_tag(const char *text, uint len)
 
     validate_tag(&tag);                 // Trim spaces and verify format
 
+    // If we're in a macro, see if we can use its tag table to jump directly
+    // to the tag. If not, we scan for it, which also takes care of reporting
+    // any errors.
+
+    if (cbuf->cache != NULL && goto_tag(&tag))
+    {
+        return;
+    }
+
     //  Start at the beginning of the command string, and search for the tag.
 
     cbuf->pos = 0;
@@ -293,6 +592,208 @@ static void find_tag(const char *text, uint len)
 }
 
 
+///
+///  @brief    Free tag table.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void free_tags(struct tags **tags)
+{
+    assert(tags != NULL);
+
+    struct tags *p = *tags;
+
+    if (p != NULL)
+    {
+        free_mem(&p->mark);
+        free_mem(&p->min);
+        free_mem(&p->hash);
+        free_mem(tags);
+    }
+}
+
+
+///
+///  @brief    Jump to tag using tag table for current macro, building the
+///            table if we don't have one yet. This sets the command string
+///            position, line number, loop level, and conditional depth just
+///            as find_tag() would after scanning the commands between here and
+///            the tag.
+///
+///  @returns  true if we jumped to tag, false if tag is missing or duplicated,
+///            or if the jump isn't valid (the caller then scans for the tag in
+///            order to issue the appropriate error).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool goto_tag(const tstring *tag)
+{
+    assert(tag != NULL);
+    assert(cbuf->cache != NULL);
+
+    struct tags *tags = cbuf->cache->tags;
+
+    // Command scanning depends on the E1 and E2 flags, so we need a new table
+    // if either of those has changed.
+
+    if (tags == NULL || !tags->done || tags->e1 != f.e1.flag
+        || tags->e2 != f.e2.flag)
+    {
+        build_tags(tag);
+
+        tags = cbuf->cache->tags;
+    }
+
+    uint_t h = hash_tag(tag->data, tag->len) & (tags->nhash - 1);
+    const struct tag *entry;
+
+    while ((entry = &tags->hash[h])->count != 0)
+    {
+        const struct mark *mark = &tags->mark[entry->mark];
+        const char *name = cbuf->data + mark->pos - 1 - mark->len;
+
+        if (mark->len == tag->len
+            && !memcmp(name, tag->data, (size_t)tag->len))
+        {
+            break;
+        }
+
+        h = (h + 1) & (tags->nhash - 1);
+    }
+
+    if (entry->count != 1)              // Missing or duplicate tag?
+    {
+        return false;
+    }
+
+    const struct mark *mark = &tags->mark[entry->mark];
+    uint_t last = entry->mark;
+    uint_t first;
+    uint_t line;
+    int depth;
+
+    if (ctrl.level != 0 && mark->pos < ctrl.loop[ctrl.level - 1].pos)
+    {
+        return false;                   // Invalid tag location
+    }
+
+    // Find the first mark that we would scan, as well as the line number and
+    // conditional depth that we would start with. Note that the scan to look
+    // for duplicate tags counts every line in the macro, and that we only
+    // keep the conditional depth if the tag follows us.
+
+    uint_t here = find_mark(tags, cbuf->pos, "Oo");
+
+    if (here == tags->nmarks)
+    {
+        return false;                   // Not at an O command we know about
+    }
+
+    if (here < last)                    // Tag follows O command
+    {
+        first = here + 1;
+        line  = cmd_line + tags->lines - tags->mark[here].line;
+        depth = (int)ctrl.depth - tags->mark[first].depth;
+    }
+    else if (ctrl.level == 0)           // Tag precedes O command, no loop
+    {
+        first = 0;
+        line  = 0;
+        depth = -tags->mark[first].depth;
+    }
+    else                                // Tag precedes O command, in loop
+    {
+        const struct loop *loop = &ctrl.loop[ctrl.level - 1];
+        uint_t start = find_mark(tags, loop->pos, "<");
+
+        if (start == tags->nmarks)
+        {
+            return false;
+        }
+
+        first = start + 1;
+        line  = loop->line - tags->mark[start].line;
+        depth = -tags->mark[first].depth;
+    }
+
+    // Any drop in the loop level below where we start means that we're
+    // leaving a loop we're in, while a tag at a higher level than the
+    // minimum means that we'd be jumping into a loop we're not in.
+
+    int level = min_level(tags, first, last);
+    uint exits = (uint)(tags->mark[first].level - level);
+
+    if (mark->level != level || exits > ctrl.level)
+    {
+        return false;
+    }
+
+    ctrl.level -= exits;
+    ctrl.depth = (uint)(depth + mark->depth);
+    cmd_line = line + mark->line;
+
+    // The +2 is for the delimiting exclamation marks.
+
+    cbuf->pos = mark->pos - (tag->len + 2);
+
+    reset_x();
+
+    return true;
+}
+
+
+///
+///  @brief    Get hash value for tag (FNV-1a).
+///
+///  @returns  Hash value.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t hash_tag(const char *text, uint_t len)
+{
+    assert(text != NULL);
+
+    uint_t hash = 2166136261u;
+
+    while (len-- != 0)
+    {
+        hash ^= (uchar)*text++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+///
+///  @brief    Get minimum loop level for range of marks.
+///
+///  @returns  Minimum loop level.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int min_level(const struct tags *tags, uint_t first, uint_t last)
+{
+    assert(tags != NULL);
+    assert(first <= last && last < tags->nmarks);
+
+    uint r = 0;
+
+    while (((uint_t)2 << r) <= last - first + 1)
+    {
+        ++r;
+    }
+
+    const int *row = tags->min + r * tags->nmarks;
+    int a = row[first];
+    int b = row[last + 1 - ((uint_t)1 << r)];
+
+    return (a < b) ? a : b;
+}
+
+
 ///
 ///  @brief    Scan ! command with format "m,n@X/text1/" (with special
 ///            delimiters).
@@ -41,9 +41,40 @@
 
 // Local functions
 
+static void end_if(struct jump *jump, char type, uint start, uint_t line,
+                   int c);
+
 static void skip_if(bool else_ok);
 
 
+///
+///  @brief    Finish skipping conditional statement. If we're executing a
+///            macro, we save the result of the skip, so that the next skip
+///            from the same position doesn't have to scan the commands again.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void end_if(struct jump *jump, char type, uint start, uint_t line,
+                   int c)
+{
+    if (jump != NULL)
+    {
+        jump->end   = cbuf->pos;
+        jump->lines = cmd_line - line;
+        jump->depth = (int)ctrl.depth - (int)start;
+        jump->low   = jump->depth;
+        jump->type  = type;
+    }
+
+    if (f.trace)
+    {
+        echo_in(c);
+    }
+}
+
+
 ///
 ///  @brief    Execute | command: 'else' clause of conditional statement. We get
 ///            here when we encounter a vertical bar while executing commands
@@ -352,9 +383,32 @@ static void skip_if(bool else_ok)
 {
     assert(ctrl.depth > 0);
 
+    struct jump *jump = NULL;
+    char type = else_ok ? '|' : '\'';
+
+    if (cbuf->cache != NULL && cmd_line != 0)
+    {
+        jump = get_jump(cbuf->cache, cbuf->pos);
+    }
+
+    if (jump != NULL && jump->type == type)
+    {
+        cbuf->pos   = jump->end;
+        cmd_line   += jump->lines;
+        ctrl.depth  = (uint)((int)ctrl.depth + jump->depth);
+
+        if (f.trace)
+        {
+            echo_in(jump->depth < 0 ? '\'' : '|');
+        }
+
+        return;
+    }
+
     struct cmd cmd;                     // Scrap command block for skip_cmd()
     uint level = 0;
     uint start = ctrl.depth;
+    uint_t line = cmd_line;
 
     while (skip_cmd(&cmd, "<>\"'|"))
     {
@@ -386,10 +440,7 @@ static void skip_if(bool else_ok)
                         throw(E_MRA);   // Missing right angle bracket
                     }
 
-                    if (f.trace)
-                    {
-                        echo_in(cmd.c1);
-                    }
+                    end_if(jump, type, start, line, cmd.c1);
 
                     return;
                 }
@@ -401,10 +452,7 @@ static void skip_if(bool else_ok)
                 {
                     if (else_ok)
                     {
-                        if (f.trace)
-                        {
-                            echo_in(cmd.c1);
-                        }
+                        end_if(jump, type, start, line, cmd.c1);
 
                         return;
                     }
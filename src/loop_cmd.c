@@ -386,7 +386,9 @@ bool scan_semi(struct cmd *cmd)
 
 
 ///
-///  @brief    Flow to end of loop.
+///  @brief    Flow to end of loop. When executing a macro, the result of the
+///            skip is saved, so that the next skip from the same position
+///            doesn't have to scan the commands again.
 ///
 ///  @returns  Nothing.
 ///
@@ -396,8 +398,38 @@ static void skip_loop(void)
 {
     assert(ctrl.level > 0);
 
+    struct jump *jump = NULL;
+
+    if (cbuf->cache != NULL && cmd_line != 0)
+    {
+        jump = get_jump(cbuf->cache, cbuf->pos);
+    }
+
+    // A saved skip can be used if it doesn't take us past the start of the
+    // conditional we're in, since that's an error we must scan for.
+
+    if (jump != NULL && jump->type == '>'
+        && (int)ctrl.depth + jump->low >= 0)
+    {
+        --ctrl.level;
+
+        cbuf->pos   = jump->end;
+        cmd_line   += jump->lines;
+        ctrl.depth  = (uint)((int)ctrl.depth + jump->depth);
+
+        if (f.trace)
+        {
+            echo_in('>');
+        }
+
+        return;
+    }
+
     struct cmd cmd;
     uint level = ctrl.level--;
+    uint start = ctrl.depth;
+    uint_t line = cmd_line;
+    int low = 0;
 
     while (skip_cmd(&cmd, "<>\"'"))
     {
@@ -411,6 +443,15 @@ static void skip_loop(void)
             case '>':                   // End of loop
                 if (--level == ctrl.level)
                 {
+                    if (jump != NULL)
+                    {
+                        jump->end   = cbuf->pos;
+                        jump->lines = cmd_line - line;
+                        jump->depth = (int)ctrl.depth - (int)start;
+                        jump->low   = low;
+                        jump->type  = '>';
+                    }
+
                     if (f.trace)
                     {
                         echo_in(cmd.c1);
@@ -432,6 +473,11 @@ static void skip_loop(void)
                     throw(E_MSC);       // Missing start of conditional
                 }
 
+                if (low > (int)ctrl.depth - (int)start)
+                {
+                    low = (int)ctrl.depth - (int)start;
+                }
+
                 break;
 
             default:
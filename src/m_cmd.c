@@ -26,6 +26,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "teco.h"
 #include "cmdbuf.h"
@@ -40,6 +41,26 @@
 
 static uint macro_depth = 0;            ///< Current macro depth
 
+///  @struct  frame
+///  @brief   State saved when a macro is called, and restored when it returns.
+///           Only the loops that are active in the caller are saved.
+
+struct frame
+{
+    struct cmd_cache *cache;            ///< Cache held by macro
+    tbuffer *cbuf;                      ///< Caller's command string
+    uint_t line;                        ///< Caller's line number
+    uint_t pos;                         ///< Saved position in macro
+    uint depth;                         ///< Caller's conditional depth
+    uint level;                         ///< Caller's loop level
+    struct loop loop[MAX_LOOPS];        ///< Caller's active loops
+};
+
+///   @var    frames
+///   @brief  Frames for macros being executed
+
+static struct frame frames[MACRO_MAX];
+
 
 ///
 ///  @brief    Check to see if we're in a macro.
@@ -93,6 +114,14 @@ void exec_M(struct cmd *cmd)
         return;
     }
 
+    // The scan data for the macro is cached with the Q-register, so that it
+    // can be reused the next time the macro is executed.
+
+    if (qreg->text.cache == NULL)
+    {
+        qreg->text.cache = new_cache(qreg->text.len);
+    }
+
     // We make a private copy of the Q-register, since some of the structure
     // members can get modified while processing the macro (esp. len).
 
@@ -132,10 +161,16 @@ void exec_macro(tbuffer *macro, struct cmd *cmd)
 
     // Save current state
 
-    struct ctrl saved_ctrl = ctrl;
-    uint_t saved_line      = cmd_line;
-    uint_t saved_pos       = macro->pos;
-    tbuffer *saved_cbuf    = cbuf;
+    struct frame *frame = &frames[macro_depth];
+    struct cmd_cache *saved_cache = macro->cache;
+
+    frame->cbuf  = cbuf;
+    frame->line  = cmd_line;
+    frame->pos   = macro->pos;
+    frame->depth = ctrl.depth;
+    frame->level = ctrl.level;
+
+    memcpy(frame->loop, ctrl.loop, ctrl.level * sizeof(ctrl.loop[0]));
 
     // Initialize for new command string
 
@@ -154,10 +189,27 @@ void exec_macro(tbuffer *macro, struct cmd *cmd)
 
     struct cmd newcmd = null_cmd;       // Initialize new command
 
-    // If we were passed the previous command, then copy any m and n arguments.
+    // Hold on to the macro's cache while we execute it, so that it won't be
+    // freed if the macro modifies its own Q-register. Macros that aren't in
+    // a Q-register (e.g., for an EI command) get a cache that lasts until we
+    // return, since their loops can execute the same text many times. The
+    // cache tables are only allocated if something is stored in them.
+
+    if (saved_cache != NULL)
+    {
+        ++saved_cache->refs;
+    }
+    else
+    {
+        macro->cache = new_cache(macro->len);
+    }
+
+    frame->cache = macro->cache;
 
     ++macro_depth;
 
+    // If we were passed the previous command, then copy any m and n arguments.
+
     if (cmd == NULL)
     {
         exec_cmd(&newcmd);
@@ -190,19 +242,26 @@ void exec_macro(tbuffer *macro, struct cmd *cmd)
 
     --macro_depth;
 
+    free_cache(&frame->cache);
+
     // Restore previous state
 
-    cbuf = saved_cbuf;                  // Restore previous command string
-    macro->pos = saved_pos;
-    cmd_line = saved_line;
-    ctrl = saved_ctrl;
+    cbuf = frame->cbuf;                 // Restore previous command string
+    macro->pos = frame->pos;
+    macro->cache = saved_cache;
+    cmd_line = frame->line;
+    ctrl.depth = frame->depth;
+    ctrl.level = frame->level;
+
+    memcpy(ctrl.loop, frame->loop, ctrl.level * sizeof(ctrl.loop[0]));
 
     delete_x();                         // Restore previous expression stack
 }
 
 
 ///
-///  @brief    Reset macro depth.
+///  @brief    Reset macro depth, and release any caches held by macros that
+///            were being executed.
 ///
 ///  @returns  Nothing.
 ///
@@ -210,7 +269,10 @@ void exec_macro(tbuffer *macro, struct cmd *cmd)
 
 void reset_macro(void)
 {
-    macro_depth = 0;
+    while (macro_depth != 0)
+    {
+        free_cache(&frames[--macro_depth].cache);
+    }
 }
 
 
@@ -165,6 +165,29 @@ static void add_mblock(void *p1, uint_t size)
 #endif
 
 
+///
+///  @brief    Record a block of memory that was allocated without calling
+///            alloc_mem() (e.g., with mmap()), so that it is included in the
+///            total allocated and checked for leaks when we exit.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void add_mem(void *p1, uint_t size)
+{
+    assert(p1 != NULL);                 // Error if no memory block
+    assert(size != 0);                  // Error if size is 0
+
+#if     DEBUG >= 2
+
+    add_mblock(p1, size);
+
+#endif
+
+}
+
+
 ///
 ///  @brief    Allocate new memory.
 ///
@@ -292,6 +315,27 @@ static void delete_mblock(void *p1)
 #endif
 
 
+///
+///  @brief    Remove a block of memory recorded by add_mem(), before it is
+///            deallocated (e.g., with munmap()).
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void delete_mem(void *p1)
+{
+    assert(p1 != NULL);                 // Error if NULL memory block
+
+#if     DEBUG >= 2
+
+    delete_mblock(p1);
+
+#endif
+
+}
+
+
 ///
 ///  @brief    Verify that all memory was deallocated before we exit from TECO.
 ///
@@ -213,9 +213,9 @@ void exec_R(struct cmd *cmd)
 
 
 ///
-///  @brief    Get no. of lines after dot. This is only used by :L commands,
-///            but if display mode is active, we can take advantage of the
-///            t->line and t->nlines variables.
+///  @brief    Get no. of lines after dot. This is only used by :L commands.
+///            The edit buffer keeps the t->line and t->nlines variables up to
+///            date regardless of whether display mode is active.
 ///
 ///  @returns  No. of lines.
 ///
@@ -223,33 +223,12 @@ void exec_R(struct cmd *cmd)
 
 static int_t lines_after(void)
 {
-    if (f.e0.display)                   // Use optimization if display active
-    {
-        return t->nlines - t->line;
-    }
-    else
-    {
-        int_t nlines = 0;
-
-        for (int_t pos = 0; pos < t->Z; ++pos)
-        {
-            int c = read_edit(pos);
-
-            if (c != EOF && isdelim(c))
-            {
-                ++nlines;
-            }
-        }
-
-        return nlines;
-    }
+    return t->nlines - t->line;
 }
 
 
 ///
-///  @brief    Get no. of lines before dot. This is only used by :L commands,
-///            but if display mode is active, we can take advantage of the
-///            t->line variable.
+///  @brief    Get no. of lines before dot. This is only used by :L commands.
 ///
 ///  @returns  No. of lines.
 ///
@@ -257,26 +236,7 @@ static int_t lines_after(void)
 
 static int_t lines_before(void)
 {
-    if (f.e0.display)                   // Use optimization if display active
-    {
-        return t->line;
-    }
-    else
-    {
-        int_t nlines = 0;
-
-        for (int_t pos = -t->dot; pos < 0; ++pos)
-        {
-            int c = read_edit(pos);
-
-            if (c != EOF && isdelim(c))
-            {
-                ++nlines;
-            }
-        }
-
-        return nlines;
-    }
+    return t->line;
 }
 
 
@@ -34,6 +34,7 @@
 #include "errors.h"
 #include "estack.h"
 #include "exec.h"
+#include "file.h"
 #include "search.h"
 
 
@@ -41,6 +42,8 @@
 
 static void exec_search(struct cmd *cmd, bool replace);
 
+static void replace_pages(struct cmd *cmd);
+
 
 ///
 ///  @brief    Execute N command: global search.
@@ -81,7 +84,19 @@ static void exec_search(struct cmd *cmd, bool replace)
 
     if (cmd->n_set && cmd->n_arg == 0)  // 0Ntext` isn't allowed
     {
-        throw(E_ISA);                   // Invalid search argument
+        if (!replace)
+        {
+            throw(E_ISA);               // Invalid search argument
+        }
+
+        if (cmd->text1.len != 0)
+        {
+            build_search(cmd->text1.data, cmd->text1.len);
+        }
+
+        replace_pages(cmd);             // 0FNold`new` => replace all
+
+        return;
     }
 
     if (!cmd->n_set)                    // Ntext` => 1Ntext`
@@ -139,6 +154,64 @@ static void exec_search(struct cmd *cmd, bool replace)
 }
 
 
+///
+///  @brief    Execute 0FN command: replace all occurrences of a string from
+///            dot to the end of the input file. Each page is rewritten in a
+///            single pass by replace_all(), and then output before the next
+///            one is read.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void replace_pages(struct cmd *cmd)
+{
+    assert(cmd != NULL);
+
+    struct search s =
+    {
+        .type       = SEARCH_N,
+        .search     = search_forward,
+        .count      = 0,
+        .text_start = 0,                // Start at current character
+        .text_end   = t->Z - t->dot,
+    };
+
+    uint_t count = 0;
+
+    for (;;)
+    {
+        count += replace_all(&s, cmd->text2.data, cmd->text2.len);
+
+        if (ofiles[ostream].fp == NULL)
+        {
+            throw(E_NFO);               // No file for output
+        }
+
+        if (!next_page((int_t)0, t->Z, f.ctrl_e, (bool)true))
+        {
+            break;
+        }
+
+        s.text_start = 0;
+        s.text_end   = t->Z - t->dot;
+    }
+
+    if (count == 0)
+    {
+        search_failure(cmd, f.ed.keepdot);
+    }
+    else if (cmd->colon)
+    {
+        store_val((int_t)count);
+    }
+    else
+    {
+        search_success(cmd);
+    }
+}
+
+
 ///
 ///  @brief    Scan FN command.
 ///
@@ -24,91 +24,1019 @@
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
+#define _FILE_OFFSET_BITS   64      ///< Allow holding files over 2 GB
+
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
 
 #include "teco.h"
 #include "ascii.h"
+#include "editbuf.h"
+#include "eflags.h"
+#include "errors.h"
+#include "file.h"
 #include "page.h"
 
 
+//  Pages are kept in memory until the total size of all in-memory pages
+//  exceeds PAGE_MEM, at which point the least recently used pages are
+//  written to a temporary holding file and their memory is released. A page
+//  is used when it is stored, when it is read back from the holding file,
+//  and when backward paging moves it to the page stack (since it will be
+//  the next page read if we then page forward). This allows backward paging
+//  without requiring virtual memory for all pages that precede the current
+//  one. PAGE_MEM is set when TECO is built (with page_mem=n), and cannot be
+//  changed at run time.
+
+#if     !defined(PAGE_MEM)
+#define PAGE_MEM    (MB * 4)        ///< Keep up to 4 MB of pages in memory
+#endif
+
+#define PAGE_BLOCK  (KB * 16)       ///< Block size for reading holding file
+
+#define NO_OFFSET   ((off_t)-1)     ///< Page not yet in holding file
+
+#define FREE_BLOCK  16              ///< Free list grows by this many entries
+
+
+///  @struct   page
+///  @brief    Description of each page stored internally.
+
+struct page
+{
+    struct page *next;                  ///< Next page in queue
+    struct page *prev;                  ///< Previous page in queue
+    struct page *newer;                 ///< Next more recently used page
+    struct page *older;                 ///< Next less recently used page
+    char *addr;                         ///< Address of page (or NULL)
+    off_t offset;                       ///< Offset of page in holding file
+    uint_t size;                        ///< Size of page in bytes
+    bool CR_out;                        ///< Copy of f.e3.CR_out
+    bool ff;                            ///< Append form feed to page
+};
+
+///  @struct   page_table
+///  @brief    Description of stored pages for output streams.
+
+struct page_table
+{
+    uint count;                         ///< Current page number
+    struct page *head;                  ///< Head of page list
+    struct page *tail;                  ///< Tail of page list
+    struct page *stack;                 ///< Saved page stack
+};
+
+///  @struct   extent
+///  @brief    Unused space in holding file, left by pages that have been
+///            deleted or read back into the edit buffer.
+
+struct extent
+{
+    off_t offset;                       ///< Offset of space in holding file
+    uint_t size;                        ///< Size of space in bytes
+};
+
+///  @struct   holding
+///  @brief    Description of holding file and in-memory pages.
+
+struct holding
+{
+    FILE *fp;                           ///< Holding file (or NULL)
+    off_t size;                         ///< Current size of holding file
+    struct extent *free;                ///< Unused space, sorted by offset
+    uint nfree;                         ///< No. of entries in free list
+    uint maxfree;                       ///< Max. entries in free list
+    uint npages;                        ///< Total no. of stored pages
+    uint_t inmem;                       ///< Bytes in in-memory pages
+    struct page *newest;                ///< Most recently used page
+    struct page *oldest;                ///< Least recently used page
+};
+
+///  @var      ptable
+///  @brief    Stored data for primary and secondary output streams.
+
+static struct page_table ptable[] =
+{
+    { .count = 0, .head = NULL, .tail = NULL, .stack = NULL },
+    { .count = 0, .head = NULL, .tail = NULL, .stack = NULL },
+};
+
+///  @var      hold
+///  @brief    Holding file shared by primary and secondary output streams.
+
+static struct holding hold =
+{
+    .fp      = NULL,
+    .size    = 0,
+    .free    = NULL,
+    .nfree   = 0,
+    .maxfree = 0,
+    .npages  = 0,
+    .inmem   = 0,
+    .newest  = NULL,
+    .oldest  = NULL,
+};
+
+// Local functions
+
+static off_t alloc_space(uint_t size);
+
+static void copy_page(struct page *page);
+
+static void delete_page(struct page *page);
+
+static void free_space(off_t offset, uint_t size);
+
+static void link_page(struct page *page);
+
+static void load_page(struct page *page);
+
+static struct page *make_page(int_t start, int_t end, bool ff);
+
+static struct page *new_page(uint_t size, bool ff);
+
+static bool pop_page(void);
+
+static void push_page(struct page *page);
+
+static void spill_pages(void);
+
+static void store_page(struct page *page);
+
+static void touch_page(struct page *page);
+
+static struct page *unlink_page(void);
+
+static void unstore_page(struct page *page);
+
+static void write_page(FILE *fp, struct page *page);
+
+
 ///
-///  @brief    Write out current page.
+///  @brief    Find space in holding file for a page, using the first unused
+///            space that is large enough, or else the end of the file.
 ///
-///  @returns  true if already have buffer data, false if not.
+///  @returns  Offset of space in holding file.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-bool page_forward(FILE *fp, int_t start, int_t end, bool ff)
+static off_t alloc_space(uint_t size)
 {
-    assert(fp != NULL);                 // Error if no file block
+    for (uint i = 0; i < hold.nfree; ++i)
+    {
+        struct extent *extent = &hold.free[i];
+
+        if (extent->size >= size)
+        {
+            off_t offset = extent->offset;
+
+            extent->offset += (off_t)size;
+            extent->size   -= size;
+
+            if (extent->size == 0)      // Remove entry if all used
+            {
+                memmove(extent, extent + 1,
+                        (size_t)(--hold.nfree - i) * sizeof(*extent));
+            }
+
+            return offset;
+        }
+    }
 
-    struct page page;
-    int last = NUL;
+    off_t offset = hold.size;
 
-    page.size = 0;                      // No. of bytes in output page
+    hold.size += (off_t)size;
+
+    return offset;
+}
 
-    // First pass - calculate how many characters we'll need to output
 
-    for (int_t i = start; i < end; ++i)
+///
+///  @brief    Copy data in page to edit buffer, and then delete it.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void copy_page(struct page *page)
+{
+    assert(page != NULL);
+
+    if (page->addr == NULL)             // Page in holding file?
     {
-        int c = read_edit(i);
+        load_page(page);
+    }
+    else
+    {
+        unstore_page(page);
+    }
+
+    kill_edit();                        // Delete all data in edit buffer
 
-        if (c == EOF)
+    // If there is a form feed in the page (because the user added it while
+    // editing), then we have to treat it as an end of page marker, and only
+    // return the data after the form feed. We also reduce the count for the
+    // current page and add it back onto the list. Note that the data before
+    // the form feed is unchanged, so any copy in the holding file remains
+    // valid, and only the space after it is released.
+
+    bool split = false;                 // true if we split the page
+    uint_t nbytes = page->size;         // No. of bytes to copy to edit buffer
+    char *p;
+
+    if (!f.e3.nopage && (p = strrchr(page->addr, '\f')) != NULL)
+    {
+        split       = true;
+        *p++        = NUL;              // Make sure we don't match next time
+        nbytes     -= (uint)(p - page->addr);
+        page->size -= nbytes + 1;
+        page->ff    = true;
+
+        if (page->offset != NO_OFFSET)
         {
-            break;
+            free_space(page->offset + (off_t)page->size, nbytes + 1);
         }
+    }
+    else
+    {
+        p = page->addr;
+    }
+
+    // Copy page data to edit buffer. Since this data originated in the edit
+    // buffer, we assume it will fit, and therefore don't bother to check for
+    // warnings or errors.
+
+    (void)insert_edit(p, (size_t)nbytes);
+    set_dot(t->B);                      // Reset to start of buffer
+
+    if (split)
+    {
+        link_page(page);
+        store_page(page);
+    }
+    else
+    {
+        f.ctrl_e = page->ff;
+
+        delete_page(page);
+    }
+}
+
+
+///
+///  @brief    Delete page, and close holding file if no pages remain.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-        // Translate LF to CR/LF if needed, unless last chr. was CR
+static void delete_page(struct page *page)
+{
+    assert(page != NULL);
+    assert(hold.npages != 0);
 
-        if (c == LF && last != CR && f.e3.CR_out)
+    if (page->addr != NULL)
+    {
+        if (page->newer != NULL || hold.newest == page) // In memory list?
         {
-            ++page.size;
+            unstore_page(page);
         }
 
-        ++page.size;
+        free_mem(&page->addr);
+    }
 
-        last = c;
+    if (page->offset != NO_OFFSET)
+    {
+        free_space(page->offset, page->size);
     }
 
-    if (ff)                             // Add a form feed if necessary
+    free_mem(&page);
+
+    if (--hold.npages == 0 && hold.fp != NULL)
     {
-        ++page.size;
+        fclose(hold.fp);                // Temporary file is deleted on close
+        free_mem(&hold.free);
+
+        hold.fp      = NULL;
+        hold.size    = 0;
+        hold.nfree   = 0;
+        hold.maxfree = 0;
     }
+}
 
-    // Second pass - fill page and then output it
 
-    page.addr = alloc_mem((uint_t)page.size); // Allocate memory for page
+///
+///  @brief    Release space in holding file, merging it with any adjacent
+///            unused space. Space at the end of the file is given back by
+///            reducing the file size, so that it gets reused for new pages.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-    char *p = page.addr;
+static void free_space(off_t offset, uint_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    uint i = 0;
 
-    for (int i = start; i < end; ++i)
+    while (i < hold.nfree && hold.free[i].offset < offset)
     {
-        int c = read_edit(i);
+        ++i;
+    }
+
+    struct extent *prev = (i != 0) ? &hold.free[i - 1] : NULL;
+    struct extent *next = (i < hold.nfree) ? &hold.free[i] : NULL;
+
+    if (prev != NULL && prev->offset + (off_t)prev->size == offset)
+    {
+        prev->size += size;             // Merge with previous space
+
+        if (next != NULL && offset + (off_t)size == next->offset)
+        {
+            prev->size += next->size;   // And with next space
 
-        if (c == EOF)
+            memmove(next, next + 1,
+                    (size_t)(--hold.nfree - i) * sizeof(*next));
+        }
+    }
+    else if (next != NULL && offset + (off_t)size == next->offset)
+    {
+        next->offset  = offset;         // Merge with next space
+        next->size   += size;
+    }
+    else                                // Add new entry to free list
+    {
+        if (hold.nfree == hold.maxfree)
+        {
+            uint_t oldsize = hold.maxfree * (uint_t)sizeof(*hold.free);
+            uint_t delta   = FREE_BLOCK * (uint_t)sizeof(*hold.free);
+
+            if (hold.free == NULL)
+            {
+                hold.free = alloc_mem(delta);
+            }
+            else
+            {
+                hold.free = expand_mem(hold.free, oldsize, delta);
+            }
+
+            hold.maxfree += FREE_BLOCK;
+        }
+
+        memmove(&hold.free[i + 1], &hold.free[i],
+                (size_t)(hold.nfree++ - i) * sizeof(*hold.free));
+
+        hold.free[i].offset = offset;
+        hold.free[i].size   = size;
+    }
+
+    // If the last unused space is at the end of the file, then shrink the
+    // file so that the space is used for the next page we write.
+
+    struct extent *last = &hold.free[hold.nfree - 1];
+
+    if (last->offset + (off_t)last->size == hold.size)
+    {
+        hold.size = last->offset;
+
+        --hold.nfree;
+    }
+}
+
+
+///
+///  @brief    Add page to tail of linked list.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void link_page(struct page *page)
+{
+    assert(page != NULL);
+
+    if (ptable[ostream].head == NULL)
+    {
+        ptable[ostream].head = page;       // Head -> new page
+    }
+    else
+    {
+        page->prev = ptable[ostream].tail; // New page -> last page
+        ptable[ostream].tail->next = page; // Last page -> new page
+    }
+
+    ptable[ostream].tail = page;           // Tail -> new page
+}
+
+
+///
+///  @brief    Read page from holding file into memory.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void load_page(struct page *page)
+{
+    assert(page != NULL);
+    assert(page->addr == NULL);
+    assert(page->offset != NO_OFFSET);
+    assert(hold.fp != NULL);
+
+    page->addr = alloc_mem(page->size + 1);
+
+    if (fseeko(hold.fp, page->offset, SEEK_SET) != 0
+        || fread(page->addr, 1uL, (size_t)page->size, hold.fp) != page->size)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+
+    page->addr[page->size] = NUL;
+}
+
+
+///
+///  @brief    Create page with data from edit buffer. Note that if we're
+///            treating form feeds as a page delimiter, then we have to adjust
+///            the page count for any form feeds that the user may have added
+///            to the current page. This is to handle the situation where the
+///            user subsequently executes -P commands.
+///
+///  @returns  Pointer to page we created.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct page *make_page(int_t start, int_t end, bool ff)
+{
+    struct page *page = new_page((uint_t)(end - start), ff);
+    char *p = page->addr;
+    const uchar *text;
+    uint_t nbytes;
+
+    for (int_t i = start; (nbytes = span_edit(i, end, &text)) != 0;
+         i += (int_t)nbytes)
+    {
+        memcpy(p, text, (size_t)nbytes);
+
+        p += nbytes;
+
+        if (ff)                         // Count any FFs user added
+        {
+            for (uint_t n = 0; n < nbytes; ++n)
+            {
+                ptable[ostream].count += (text[n] == FF);
+            }
+        }
+    }
+
+    assert(p - page->addr == (long)page->size);
+
+    store_page(page);
+
+    return page;
+}
+
+
+///
+///  @brief    Allocate a new page, with room for the specified no. of bytes
+///            plus a terminating NUL. The caller is responsible for copying
+///            data to the page and then storing it.
+///
+///  @returns  Pointer to page we created.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct page *new_page(uint_t size, bool ff)
+{
+    struct page *page = alloc_mem((uint_t)sizeof(*page));
+
+    page->next   = page->prev  = NULL;
+    page->newer  = page->older = NULL;
+    page->offset = NO_OFFSET;
+    page->size   = size;
+    page->CR_out = f.e3.CR_out;
+    page->ff     = ff;
+    page->addr   = alloc_mem(page->size + 1);
+
+    page->addr[page->size] = NUL;       // Stop any search for FF
+
+    ++hold.npages;
+
+    return page;
+}
+
+
+///
+///  @brief    Read in previous page.
+///
+///  @returns  true if we have a new page, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool page_backward(int_t count, bool ff)
+{
+    assert(count < 0);
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    // Create a new page with data from edit buffer and push it on the stack.
+
+    struct page *page;
+
+    if (t->Z != 0)
+    {
+        set_dot(t->B);
+
+        page = make_page(t->B, t->Z, ff);
+
+        kill_edit();
+
+        push_page(page);
+    }
+
+    // Now unlink pages from linked list and push them on the stack, until we
+    // find the one we want (which will then be popped off the stack).
+
+    while (count++ < 0)
+    {
+        if ((page = unlink_page()) == NULL)
         {
             break;
         }
 
-        // Translate LF to CR/LF if needed, unless last chr. was CR
+        push_page(page);                // Then push it on stack
 
-        if (c == LF && last != CR && f.e3.CR_out)
+        if (count == 0)
         {
-            *p++ = CR;
+            bool havedata = pop_page();
+
+            if (havedata)
+            {
+                --ptable[ostream].count;
+            }
+
+            return havedata;
         }
+    }
 
-        *p++ = (char)c;
+    if (ptable[ostream].count > 0)
+    {
+        --ptable[ostream].count;
     }
 
-    if (ff)                             // Add a form feed if necessary
+    return f.ctrl_e = false;
+}
+
+
+///
+///  @brief    Get page count for current page.
+///
+///  @returns  Page number (0 if no data in buffer).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint page_count(void)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    return ptable[ostream].count;
+}
+
+
+///
+///  @brief    Flush out remaining pages.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void page_flush(FILE *fp)
+{
+    assert(fp != NULL);                 // Error if no file block
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page *page;
+
+    // Write out all pages in queue.
+
+    while ((page = ptable[ostream].head) != NULL)
+    {
+        ptable[ostream].head = page->next;
+
+        write_page(fp, page);
+    }
+
+    ptable[ostream].tail = NULL;
+
+    while ((page = ptable[ostream].stack) != NULL)
+    {
+        ptable[ostream].stack = page->next;
+
+        write_page(fp, page);
+    }
+
+    ptable[ostream].count = 0;
+}
+
+
+///
+///  @brief    Write out current page.
+///
+///  @returns  true if already have buffer data, false if not.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool page_forward(FILE *unused, int_t start, int_t end, bool ff)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    if (start != end)
+    {
+        struct page *page = make_page(start, end, ff);
+
+        link_page(page);
+    }
+
+    ++ptable[ostream].count;
+
+    return pop_page();
+}
+
+
+///
+///  @brief    Write out a page that was read directly from the input file,
+///            without being loaded into the edit buffer. This has the same
+///            effect as loading the page and then calling page_forward().
+///            Since a page from the input file can only contain a FF if we
+///            aren't using FF as a page delimiter, we don't need to count FFs
+///            here as make_page() does.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void page_skip(FILE *unused, const char *text, uint_t nbytes, bool ff)
+{
+    assert(text != NULL || nbytes == 0);
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+    assert(ptable[ostream].stack == NULL);
+
+    if (nbytes != 0)
+    {
+        struct page *page = new_page(nbytes, ff);
+
+        memcpy(page->addr, text, (size_t)nbytes);
+
+        store_page(page);
+        link_page(page);
+    }
+
+    ++ptable[ostream].count;
+}
+
+
+///
+///  @brief    Pop page from stack, and copy to edit buffer.
+///
+///  @returns  true if there was a page on stack, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool pop_page(void)
+{
+    struct page *page = ptable[ostream].stack;
+
+    if (page == NULL)
+    {
+        return false;
+    }
+
+    ptable[ostream].stack = page->next;
+
+    page->next = NULL;
+
+    copy_page(page);
+
+    return true;
+}
+
+
+///
+///  @brief    Push page onto stack.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void push_page(struct page *page)
+{
+    assert(page != NULL);
+
+    page->next = ptable[ostream].stack;
+
+    ptable[ostream].stack = page;
+
+    touch_page(page);
+}
+
+
+///
+///  @brief    Reset all pages (used by EK and EX commands).
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void reset_pages(uint stream)
+{
+    assert(stream == OFILE_PRIMARY || stream == OFILE_SECONDARY);
+
+    struct page *page;
+
+    while ((page = ptable[stream].head) != NULL)
+    {
+        ptable[stream].head = page->next;
+
+        delete_page(page);
+    }
+
+    ptable[stream].tail = NULL;
+
+    // Free up anything on the page stack
+
+    while ((page = ptable[stream].stack) != NULL)
+    {
+        ptable[stream].stack = page->next;
+
+        delete_page(page);
+    }
+}
+
+
+///
+///  @brief    Set page count for current page.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void set_page(uint page)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    ptable[ostream].count = page;
+}
+
+
+///
+///  @brief    Move the least recently used in-memory pages to the holding file
+///            until the memory used by pages is within our limit. Pages that are already
+///            in the holding file are not written again.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void spill_pages(void)
+{
+    struct page *page;
+
+    while (hold.inmem > PAGE_MEM && (page = hold.oldest) != NULL)
+    {
+        if (page->offset == NO_OFFSET)
+        {
+            if (hold.fp == NULL && (hold.fp = tmpfile()) == NULL)
+            {
+                throw(E_ERR, NULL);     // General error
+            }
+
+            off_t offset = alloc_space(page->size);
+
+            if (fseeko(hold.fp, offset, SEEK_SET) != 0
+                || fwrite(page->addr, 1uL, (size_t)page->size, hold.fp)
+                   != page->size)
+            {
+                free_space(offset, page->size);
+
+                throw(E_ERR, NULL);     // General error
+            }
+
+            page->offset = offset;
+        }
+
+        unstore_page(page);
+        free_mem(&page->addr);
+    }
+}
+
+
+///
+///  @brief    Add page to list of in-memory pages, and move older pages to
+///            holding file if necessary.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void store_page(struct page *page)
+{
+    assert(page != NULL);
+    assert(page->addr != NULL);
+
+    page->newer = NULL;
+    page->older = hold.newest;
+
+    if (hold.newest == NULL)
+    {
+        hold.oldest = page;
+    }
+    else
+    {
+        hold.newest->newer = page;
+    }
+
+    hold.newest = page;
+    hold.inmem += page->size;
+
+    spill_pages();
+}
+
+
+///
+///  @brief    Mark an in-memory page as the most recently used, so that it is
+///            the last to be moved to the holding file. This doesn't change
+///            the memory used by pages, so store_page() won't move anything.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void touch_page(struct page *page)
+{
+    assert(page != NULL);
+
+    if (page->newer != NULL)            // In memory, but not most recent?
+    {
+        unstore_page(page);
+        store_page(page);
+    }
+}
+
+
+///
+///  @brief    Unlink page from end of linked list.
+///
+///  @returns  Returned page, or NULL if list is empty.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct page *unlink_page(void)
+{
+    struct page *page;
+
+    if ((page = ptable[ostream].tail) == NULL)
+    {
+        return NULL;
+    }
+
+    assert(page->next == NULL);
+
+    if (page->prev == NULL)             // Only page in list?
+    {
+        ptable[ostream].head = NULL;
+        ptable[ostream].tail = NULL;
+    }
+    else
+    {
+        ptable[ostream].tail = page->prev;
+
+        page->prev->next = NULL;
+        page->prev       = NULL;
+        page->next       = NULL;
+    }
+
+    return page;
+}
+
+
+///
+///  @brief    Remove page from list of in-memory pages.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void unstore_page(struct page *page)
+{
+    assert(page != NULL);
+    assert(hold.inmem >= page->size);
+
+    if (page->newer == NULL)
+    {
+        hold.newest = page->older;
+    }
+    else
+    {
+        page->newer->older = page->older;
+    }
+
+    if (page->older == NULL)
+    {
+        hold.oldest = page->newer;
+    }
+    else
+    {
+        page->older->newer = page->newer;
+    }
+
+    page->newer = page->older = NULL;
+    hold.inmem -= page->size;
+}
+
+
+///
+///  @brief    Write page to file, reading it from the holding file if it is
+///            no longer in memory.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void write_page(FILE *fp, struct page *page)
+{
+    assert(fp != NULL);
+    assert(page != NULL);
+
+    if (page->addr != NULL)
+    {
+        (void)write_text(fp, page->addr, page->size, page->CR_out, NUL);
+    }
+    else
     {
-        *p++ = FF;
+        char block[PAGE_BLOCK];
+        uint_t size = page->size;
+        int last = NUL;
+
+        if (fseeko(hold.fp, page->offset, SEEK_SET) != 0)
+        {
+            throw(E_ERR, NULL);         // General error
+        }
+
+        while (size != 0)
+        {
+            uint_t nbytes = size < PAGE_BLOCK ? size : PAGE_BLOCK;
+
+            if (fread(block, 1uL, (size_t)nbytes, hold.fp) != nbytes)
+            {
+                throw(E_ERR, NULL);     // General error
+            }
+
+            last  = write_text(fp, block, nbytes, page->CR_out, last);
+            size -= nbytes;
+        }
     }
 
-    assert((uint)(p - page.addr) == page.size); // Verify no. of output bytes
+    if (page->ff)
+    {
+        fputc(FF, fp);
+    }
+
+    delete_page(page);
+}
 
-    fwrite(page.addr, (size_t)page.size, 1uL, fp);
 
-    free_mem(&page.addr);
+///
+///  @brief    Read in previous page, discarding current page.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void yank_backward(FILE *unused)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page *page;
+
+    if (!pop_page())
+    {
+        if ((page = unlink_page()) == NULL)
+        {
+            kill_edit();
+        }
+        else
+        {
+            copy_page(page);
+        }
+    }
+
+    if (ptable[ostream].count > 0)
+    {
+        --ptable[ostream].count;
+    }
 }
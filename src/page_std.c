@@ -115,29 +115,42 @@ bool page_forward(FILE *fp, int_t start, int_t end, bool ff)
     assert(fp != NULL);                 // Error if no file block
 
     int last = NUL;
+    const uchar *text;
+    uint_t nbytes;
 
-    // First pass - calculate how many characters we'll need to output
+    for (int_t i = start; (nbytes = span_edit(i, end, &text)) != 0;
+         i += (int_t)nbytes)
+    {
+        last = write_text(fp, (const char *)text, nbytes, f.e3.CR_out, last);
+    }
 
-    for (int_t i = start; i < end; ++i)
+    if (ff)                             // Add a form feed if necessary
     {
-        int c = read_edit(i);
+        fputc(FF, fp);
+    }
 
-        if (c == EOF)
-        {
-            break;
-        }
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
 
-        // Translate LF to CR/LF if needed, unless last chr. was CR
+    ++ptable[ostream].count;
 
-        if (c == LF && last != CR && f.e3.CR_out)
-        {
-            fputc(CR, fp);
-        }
+    return false;
+}
 
-        fputc(c, fp);
 
-        last = c;
-    }
+///
+///  @brief    Write out a page that was read directly from the input file,
+///            without being loaded into the edit buffer.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void page_skip(FILE *fp, const char *text, uint_t nbytes, bool ff)
+{
+    assert(fp != NULL);                 // Error if no file block
+    assert(text != NULL || nbytes == 0);
+
+    (void)write_text(fp, text, nbytes, f.e3.CR_out, NUL);
 
     if (ff)                             // Add a form feed if necessary
     {
@@ -147,8 +160,6 @@ bool page_forward(FILE *fp, int_t start, int_t end, bool ff)
     assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
 
     ++ptable[ostream].count;
-
-    return false;
 }
 
 
@@ -46,7 +46,6 @@ struct page
     struct page *prev;                  ///< Previous page in queue
     char *addr;                         ///< Address of page
     uint_t size;                        ///< Size of page in bytes
-    uint_t cr;                          ///< No. of added CRs in page
     bool CR_out;                        ///< Copy of f.e3.CR_out
     bool ff;                            ///< Append form feed to page
 };
@@ -79,6 +78,8 @@ static void link_page(struct page *page);
 
 static struct page *make_page(int_t start, int_t end, bool ff);
 
+static struct page *new_page(uint_t size, bool ff);
+
 static bool pop_page(void);
 
 static void push_page(struct page *page);
@@ -182,37 +183,25 @@ static void link_page(struct page *page)
 
 static struct page *make_page(int_t start, int_t end, bool ff)
 {
-    struct page *page = alloc_mem((uint_t)sizeof(*page));
-
-    page->next   = page->prev = NULL;
-    page->size   = (uint)(end - start);
-    page->cr     = 0;
-    page->CR_out = f.e3.CR_out;
-    page->ff     = ff;
-    page->addr   = alloc_mem(page->size);
-
-    char *p  = page->addr;
-    char last = NUL;
+    struct page *page = new_page((uint_t)(end - start), ff);
+    char *p = page->addr;
+    const uchar *text;
+    uint_t nbytes;
 
-    for (int_t i = start; i < end; ++i)
+    for (int_t i = start; (nbytes = span_edit(i, end, &text)) != 0;
+         i += (int_t)nbytes)
     {
-        int c = read_edit(i);
+        memcpy(p, text, (size_t)nbytes);
 
-        if (c == EOF)
-        {
-            break;
-        }
+        p += nbytes;
 
-        if (c == LF && last != CR && page->CR_out)
-        {
-            ++page->cr;
-        }
-        else if (ff && c == FF)
+        if (ff)                         // Count any FFs user added
         {
-            ++ptable[ostream].count;
+            for (uint_t n = 0; n < nbytes; ++n)
+            {
+                ptable[ostream].count += (text[n] == FF);
+            }
         }
-
-        *p++ = last = (char)c;
     }
 
     assert(p - page->addr == (ptrdiff_t)page->size);
@@ -221,6 +210,27 @@ static struct page *make_page(int_t start, int_t end, bool ff)
 }
 
 
+///
+///  @brief    Allocate a new page, with room for the specified no. of bytes.
+///
+///  @returns  Pointer to page we created.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct page *new_page(uint_t size, bool ff)
+{
+    struct page *page = alloc_mem((uint_t)sizeof(*page));
+
+    page->next   = page->prev = NULL;
+    page->size   = size;
+    page->CR_out = f.e3.CR_out;
+    page->ff     = ff;
+    page->addr   = alloc_mem(page->size);
+
+    return page;
+}
+
+
 ///
 ///  @brief    Read in previous page.
 ///
@@ -357,6 +367,37 @@ bool page_forward(FILE *unused, int_t start, int_t end, bool ff)
 }
 
 
+///
+///  @brief    Write out a page that was read directly from the input file,
+///            without being loaded into the edit buffer. This has the same
+///            effect as loading the page and then calling page_forward().
+///            Since a page from the input file can only contain a FF if we
+///            aren't using FF as a page delimiter, we don't need to count FFs
+///            here as make_page() does.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void page_skip(FILE *unused, const char *text, uint_t nbytes, bool ff)
+{
+    assert(text != NULL || nbytes == 0);
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+    assert(ptable[ostream].stack == NULL);
+
+    if (nbytes != 0)
+    {
+        struct page *page = new_page(nbytes, ff);
+
+        memcpy(page->addr, text, (size_t)nbytes);
+
+        link_page(page);
+    }
+
+    ++ptable[ostream].count;
+}
+
+
 ///
 ///  @brief    Pop page from stack, and copy to edit buffer.
 ///
@@ -496,32 +537,13 @@ static void write_page(FILE *fp, struct page *page)
     assert(fp != NULL);
     assert(page != NULL);
 
-    char   last   = NUL;
-    uint_t nbytes = page->size + page->cr + (page->ff ? 1 : 0);
-    char   *src   = page->addr;
-    char   *dst   = alloc_mem(nbytes);
-    char   *p     = dst;
-
-    while (page->size-- > 0)
-    {
-        char c = *src++;
-
-        if (c == LF && last != CR && page->CR_out)
-        {
-            *p++ = CR;
-        }
-
-        *p++ = last = c;
-    }
+    (void)write_text(fp, page->addr, page->size, page->CR_out, NUL);
 
     if (page->ff)
     {
-        *p++ = FF;
+        fputc(FF, fp);
     }
 
-    fwrite(dst, (ulong)nbytes, 1uL, fp);
-
-    free_mem(&dst);
     free_mem(&page->addr);
     free_mem(&page);
 }
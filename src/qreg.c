@@ -26,6 +26,7 @@
 
 #include <assert.h>
 #include <limits.h>                 //lint !e451
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -132,11 +133,14 @@ static uint qstack_depth = 0;       ///< Current Q-register stack depth
 static struct qreg qglobal[QCOUNT];
 
 ///  @struct qlocal
-///  @brief  Local Q-register set.
+///  @brief  Local Q-register set. Registers are only initialized when they
+///          are first used, so a macro call doesn't have to clear the whole
+///          set.
 
 struct qlocal
 {
     struct qlocal *next;                ///< Next item in list
+    uint64_t used;                      ///< Bit mask of initialized registers
     struct qreg qreg[QCOUNT];           ///< Local Q-register set
 };
 
@@ -150,6 +154,12 @@ static struct qlocal local_base;
 
 static struct qlocal *local_head = &local_base;
 
+///  @var    local_pool
+///  @brief  Local Q-register sets for macro calls. These are allocated when
+///          first needed, and are reused until we exit.
+
+static struct qlocal *local_pool[QLOCAL_MAX];
+
 ////////////////////////////////////////////////////////////////////////////////
 ///
 ///  Definitions for Q-register push-down list. This is actually implemented as
@@ -175,6 +185,12 @@ static struct qlist *list_head = NULL;
 
 // Local functions
 
+static void expand_qtext(struct qreg *qreg, uint_t nbytes);
+
+static void free_qlocal(struct qlocal *qlocal);
+
+static INLINE struct qreg *local_qreg(struct qlocal *qlocal, int i);
+
 static INLINE struct qreg *qregister(int qindex);
 
 
@@ -189,23 +205,39 @@ void append_qchr(int qindex, int c)
 {
     struct qreg *qreg = qregister(qindex);
 
-    if (qreg->text.data == NULL)
-    {
-        qreg->text.pos  = 0;
-        qreg->text.len  = 0;
-        qreg->text.size = KB;
-        qreg->text.data = alloc_mem((uint_t)qreg->text.size);
-    }
-    else
+    free_cache(&qreg->text.cache);      // Text is changing
+
+    expand_qtext(qreg, (uint_t)1);
+
+    qreg->text.data[qreg->text.len++] = (char)c;
+}
+
+
+///
+///  @brief    Append string to Q-register.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void append_qtext(int qindex, const char *text, uint_t nbytes)
+{
+    assert(text != NULL);
+
+    if (nbytes == 0)
     {
-        if (qreg->text.len == qreg->text.size)
-        {
-            qreg->text.data = expand_mem(qreg->text.data, qreg->text.size, KB);
-            qreg->text.size += KB;
-        }
+        return;
     }
 
-    qreg->text.data[qreg->text.len++] = (char)c;
+    struct qreg *qreg = qregister(qindex);
+
+    free_cache(&qreg->text.cache);      // Text is changing
+
+    expand_qtext(qreg, nbytes);
+
+    memcpy(qreg->text.data + qreg->text.len, text, (size_t)nbytes);
+
+    qreg->text.len += nbytes;
 }
 
 
@@ -220,6 +252,7 @@ void delete_qtext(int qindex)
 {
     struct qreg *qreg = qregister(qindex);
 
+    free_cache(&qreg->text.cache);
     free_mem(&qreg->text.data);
 
     qreg->text.size = 0;
@@ -260,13 +293,12 @@ void exit_qreg(void)
     {
         assert(local_head->next == NULL); // Error if more than one set
 
-        for (uint i = 0; i < QCOUNT; ++i)
-        {
-            if (local_head->qreg[i].text.data != NULL)
-            {
-                free_mem(&local_head->qreg[i].text.data);
-            }
-        }
+        free_qlocal(local_head);
+    }
+
+    for (uint i = 0; i < QLOCAL_MAX; ++i)
+    {
+        free_mem(&local_pool[i]);
     }
 
     // Free the global Q-registers
@@ -275,11 +307,82 @@ void exit_qreg(void)
     {
         struct qreg *qreg = &qglobal[i];
 
+        free_cache(&qreg->text.cache);
         free_mem(&qreg->text.data);
     }
 }
 
 
+///
+///  @brief    Make room for more text in Q-register. The text storage is
+///            at least doubled each time it has to grow, so that appending
+///            a character at a time doesn't take quadratic time.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void expand_qtext(struct qreg *qreg, uint_t nbytes)
+{
+    assert(qreg != NULL);
+
+    const uint_t max = (uint_t)-1 - (KB - 1);
+
+    if (nbytes > max - qreg->text.len)  // Would size wrap around?
+    {
+        throw(E_MEM);                   // Memory overflow
+    }
+
+    uint_t size = qreg->text.len + nbytes + KB - 1; // Round up to next KB
+
+    size -= size % KB;
+
+    if (qreg->text.data == NULL)
+    {
+        qreg->text.pos  = 0;
+        qreg->text.len  = 0;
+        qreg->text.size = size;
+        qreg->text.data = alloc_mem((uint_t)qreg->text.size);
+    }
+    else if (qreg->text.len + nbytes > qreg->text.size)
+    {
+        // Double the size if we can, else just use as much as we need.
+
+        if (qreg->text.size <= max / 2 && size < qreg->text.size * 2)
+        {
+            size = qreg->text.size * 2;
+        }
+
+        qreg->text.data = expand_mem(qreg->text.data, qreg->text.size,
+                                     size - qreg->text.size);
+        qreg->text.size = size;
+    }
+}
+
+
+///
+///  @brief    Free text in local Q-register set, and mark all of its registers
+///            as uninitialized.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void free_qlocal(struct qlocal *qlocal)
+{
+    assert(qlocal != NULL);
+
+    for (uint i = 0; qlocal->used != 0; ++i, qlocal->used >>= 1)
+    {
+        if (qlocal->used & 1)
+        {
+            free_cache(&qlocal->qreg[i].text.cache);
+            free_mem(&qlocal->qreg[i].text.data);
+        }
+    }
+}
+
+
 ///
 ///  @brief    Get size of text in all Q-registers.
 ///
@@ -308,8 +411,11 @@ uint_t get_qall(void)
     {
         for (int_t i = 0; i < QCOUNT; ++i)
         {
-            qreg = &qnext->qreg[i];
-            n += qreg->text.len;
+            if (qnext->used & ((uint64_t)1 << i))
+            {
+                qreg = &qnext->qreg[i];
+                n += qreg->text.len;
+            }
         }
 
         qnext = qnext->next;
@@ -400,7 +506,7 @@ struct qreg *get_qreg(int qindex)
 {
     if (qindex >= QCOUNT)
     {
-        return &local_head->qreg[qindex - QCOUNT];
+        return local_qreg(local_head, qindex - QCOUNT);
     }
     else
     {
@@ -437,6 +543,30 @@ void init_qreg(void)
 }
 
 
+///
+///  @brief    Get local Q-register, initializing it if this is its first use.
+///
+///  @returns  Pointer to data.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static INLINE struct qreg *local_qreg(struct qlocal *qlocal, int i)
+{
+    assert(qlocal != NULL);
+
+    struct qreg *qreg = &qlocal->qreg[i];
+
+    if (!(qlocal->used & ((uint64_t)1 << i)))
+    {
+        qlocal->used |= (uint64_t)1 << i;
+
+        memset(qreg, '\0', sizeof(*qreg));
+    }
+
+    return qreg;
+}
+
+
 ///
 ///  @brief    Pop local Q-register set.
 ///
@@ -450,15 +580,7 @@ void pop_qlocal(void)
 
     local_head = saved_set->next;
 
-    for (uint i = 0; i < QCOUNT; ++i)
-    {
-        if (saved_set->qreg[i].text.data != NULL)
-        {
-            free_mem(&saved_set->qreg[i].text.data);
-        }
-    }
-
-    free_mem(&saved_set);
+    free_qlocal(saved_set);             // Set stays in pool for reuse
 
     --qlocal_depth;
 }
@@ -484,6 +606,8 @@ bool pop_qreg(int qindex)
 
     list_head = savedq->next;
 
+    free_cache(&qreg->text.cache);
+
     if (qreg->text.data != NULL && qreg->text.data != savedq->qreg.text.data)
     {
         free_mem(&qreg->text.data);
@@ -538,10 +662,18 @@ void push_qlocal(void)
         throw(E_MAX);
     }
 
-    ++qlocal_depth;
+    struct qlocal *qlocal = local_pool[qlocal_depth];
 
-    struct qlocal *qlocal = alloc_mem((uint_t)sizeof(*qlocal));
+    if (qlocal == NULL)
+    {
+        qlocal = alloc_mem((uint_t)sizeof(*qlocal));
 
+        local_pool[qlocal_depth] = qlocal;
+    }
+
+    ++qlocal_depth;
+
+    qlocal->used = 0;                   // No registers initialized yet
     qlocal->next = local_head;
 
     local_head = qlocal;
@@ -567,8 +699,11 @@ bool push_qreg(int qindex)
     struct qreg *qreg    = qregister(qindex);
     struct qlist *savedq = alloc_mem((uint_t)sizeof(*savedq));
 
+    // Only the text itself is copied, since the Q-register may have a lot
+    // of unused storage after appending text.
+
     savedq->qreg.n         = qreg->n;
-    savedq->qreg.text.size = qreg->text.size;
+    savedq->qreg.text.size = qreg->text.len;
     savedq->qreg.text.pos  = qreg->text.pos;
     savedq->qreg.text.len  = qreg->text.len;
 
@@ -581,7 +716,7 @@ bool push_qreg(int qindex)
         savedq->qreg.text.data = alloc_mem(savedq->qreg.text.size);
 
         memcpy(savedq->qreg.text.data, qreg->text.data,
-               (size_t)savedq->qreg.text.size);
+               (size_t)savedq->qreg.text.len);
     }
 
     savedq->next = list_head;
@@ -607,7 +742,7 @@ static INLINE struct qreg *qregister(int qindex)
     }
     else
     {
-        return &local_head->qreg[qindex - QCOUNT];
+        return local_qreg(local_head, qindex - QCOUNT);
     }
 }
 
@@ -629,15 +764,7 @@ void reset_qreg(void)
 
             local_head = saved_set->next;
 
-            for (uint i = 0; i < QCOUNT; ++i)
-            {
-                if (saved_set->qreg[i].text.data != NULL)
-                {
-                    free_mem(&saved_set->qreg[i].text.data);
-                }
-            }
-
-            free_mem(&saved_set);
+            free_qlocal(saved_set);
         }
     }
 
@@ -692,6 +819,7 @@ void store_qchr(int qindex, int c)
 {
     struct qreg *qreg = qregister(qindex);
 
+    free_cache(&qreg->text.cache);
     free_mem(&qreg->text.data);
 
     qreg->text.pos  = 0;
@@ -732,6 +860,7 @@ void store_qtext(int qindex, tbuffer *text)
 
     struct qreg *qreg = get_qreg(qindex);
 
+    free_cache(&qreg->text.cache);
     free_mem(&qreg->text.data);
 
     qreg->text = *text;
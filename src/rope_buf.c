@@ -0,0 +1,1410 @@
+///
+///  @file    rope_buf.c
+///  @brief   Text buffer functions using a rope (balanced tree of text chunks).
+///
+///  @copyright 2019-2023 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+///  The rope is stored as a treap (a binary tree that is balanced by random
+///  node priorities), in which each node holds a chunk of up to CHUNK_SIZE
+///  bytes of text, and the in-order traversal of the tree yields the contents
+///  of the edit buffer. Each node also keeps the total number of bytes and the
+///  total number of line delimiters in its subtree, which allows any position
+///  or line to be found in O(log n) time, and any insertion or deletion to be
+///  done without moving more than a chunk's worth of data.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+
+#if     !defined(NDEBUG)
+
+#include <ctype.h>
+
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teco.h"
+#include "ascii.h"
+#include "editbuf.h"
+#include "eflags.h"
+#include "file.h"
+#include "page.h"
+#include "search.h"
+
+
+#if     !defined(EDIT_MAX)
+
+#if     INT_T == 64
+
+#if     defined(PAGE_VM) || defined(PAGE_FILE)
+#define EDIT_MAX    (GB * 16)       ///< Maximum size is 16 GB (w/ VM)
+#else
+#define EDIT_MAX    (MB)            ///< Maximum size is 1 MB (w/o VM)
+#endif
+
+#elif   INT_T == 32
+
+#if     defined(PAGE_VM) || defined(PAGE_FILE)
+#define EDIT_MAX    (GB)            ///< Maximum size is 1 GB (w/ VM)
+#else
+#define EDIT_MAX    (MB)            ///< Maximum size is 1 MB (w/o VM)
+#endif
+
+#else
+
+#error  Invalid integer size: expected 32, or 64
+
+#endif
+
+#endif
+
+#if     !defined(EDIT_INIT)
+#if     defined(PAGE_VM) || defined(PAGE_FILE)
+
+#define EDIT_INIT   (KB * 64)       ///< Initial size is 64 KB
+
+#else
+
+#define EDIT_INIT   (KB * 8)        ///< Initial size is 8 KB (w/o VM)
+
+#endif
+#endif
+
+#define EDIT_MIN    (KB)            ///< Minimum size is 1 KB
+
+#define CHUNK_SIZE  (KB * 4)        ///< Maximum no. of bytes in a node
+
+
+///  @struct  node
+///
+///  @brief   Rope node, containing one chunk of text.
+
+struct node
+{
+    struct node *left;          ///< Left subtree (preceding text)
+    struct node *right;         ///< Right subtree (following text)
+    uint prio;                  ///< Random priority (for balancing)
+    uint_t len;                 ///< No. of bytes in this chunk
+    uint_t nl;                  ///< No. of delimiters in this chunk
+    uint_t sum_len;             ///< No. of bytes in subtree
+    uint_t sum_nl;              ///< No. of delimiters in subtree
+    uchar text[CHUNK_SIZE];     ///< Text for chunk
+};
+
+
+///  @var     eb
+///
+///  @brief   Edit buffer data (internal)
+
+static struct
+{
+    struct node *root;          ///< Root of tree
+    struct node *cache;         ///< Node most recently read
+    struct node *spare;         ///< Deleted nodes kept for reuse (ED&512)
+    uint_t start;               ///< Position of first byte in cached node
+    uint seed;                  ///< Seed for node priorities
+    const uint_t min;           ///< Minimum buffer size (fixed)
+    const uint_t max;           ///< Maximum buffer size (fixed)
+    struct edit t;              ///< Read/write copies of public variables
+} eb =
+{
+    .root   = NULL,
+    .cache  = NULL,
+    .spare  = NULL,
+    .start  = 0,
+    .seed   = 2463534242u,
+    .min    = EDIT_MIN,
+    .max    = EDIT_MAX,
+    .t =
+    {
+        .size   = EDIT_INIT,
+        .B      = 0,
+        .Z      = 0,
+        .dot    = 0,
+        .nextc  = EOF,
+        .c      = EOF,
+        .lastc  = EOF,
+        .len    = 0,
+        .pos    = 0,
+        .line   = 0,
+        .nlines = 0,
+    },
+};
+
+const struct edit *t = &eb.t;       ///< Read-only pointers to public variables
+
+
+// Local functions
+
+static uint_t count_lines(uint_t pos);
+
+static void end_insert(uint_t nbytes, uint_t ndelims);
+
+static void find_node(uint_t pos);
+
+static void free_node(struct node *node);
+
+static void free_spare(void);
+
+static void free_tree(struct node *node);
+
+static bool insert_chunk(struct node *node, uint_t pos, const uchar *p,
+                         uint_t nbytes, uint_t ndelims);
+
+static uint_t insert_text(uint_t pos, const uchar *p, uint_t nbytes);
+
+static struct node *join_tree(struct node *left, struct node *right);
+
+static uint_t line_start(uint_t nlines);
+
+static struct node *make_node(const uchar *p, uint_t nbytes);
+
+static struct node *merge_tree(struct node *left, struct node *right);
+
+static int_t next_line(uint_t nlines);
+
+static int_t prev_line(uint_t nlines);
+
+static int read_pos(uint_t pos);
+
+static void reset_edit(void);
+
+static void set_vars(void);
+
+static void split_tree(struct node *node, uint_t pos, struct node **left,
+                       struct node **right);
+
+static bool start_insert(uint_t nbytes);
+
+static void update_node(struct node *node);
+
+
+///
+///  @brief    Append to edit buffer. Similar to insert_edit(), but adds an
+///            entire file to the buffer.
+///
+///  @returns  true if we can continue reading lines, else false (because we
+///            encountered either an EOF or a FF).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool append_edit(struct ifile *ifile, bool single)
+{
+    assert(ifile != NULL);
+
+    uchar block[CHUNK_SIZE];
+    uint_t total = 0;
+    uint_t ndelims = 0;
+    bool more;
+
+    // Read text until end of file or end of page. Data is read into a local
+    // block, and added to the rope one chunk at a time.
+
+    do
+    {
+        uint_t nbytes = sizeof(block);
+
+        more = read_input(ifile, block, &nbytes, single);
+
+        if (nbytes != 0)
+        {
+            ndelims += insert_text((uint_t)eb.t.dot + total, block, nbytes);
+            total   += nbytes;
+        }
+    } while (more);
+
+    if (total != 0)
+    {
+        // Appending a file is not limited by the current buffer size, but we
+        // adjust the size so that it always reflects what the buffer holds.
+
+        if (eb.t.size < (uint_t)eb.t.Z)
+        {
+            eb.t.size = ((uint_t)eb.t.Z + KB - 1) & ~(KB - 1);
+        }
+
+        end_insert(total, ndelims);
+    }
+
+    return !ifile->eof;
+}
+
+
+///
+///  @brief    Change case of character at current position of dot. Since this
+///            will never add or delete any delimiters, it won't affect our
+///            line number, or the total number of lines in the buffer.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void change_dot(int c)
+{
+    assert(isalpha(c));
+
+    (void)read_pos((uint_t)eb.t.dot);   // Make sure dot is in cached node
+
+    assert(eb.cache != NULL);
+
+    eb.cache->text[(uint_t)eb.t.dot - eb.start] = eb.t.c = (uchar)c;
+
+    reset_ngrams();                     // Discard any search index
+    f.e0.window = true;                 // Window refresh needed
+}
+
+
+///
+///  @brief    Check whether input file used as edit buffer has changed. Input
+///            files are always copied into the rope, so there's nothing to do.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void check_edit(void)
+{
+}
+
+
+///
+///  @brief    Count the line delimiters preceding a position in the buffer.
+///
+///  @returns  No. of delimiters.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t count_lines(uint_t pos)
+{
+    uint_t line = 0;
+    uint_t start = 0;
+    struct node *node = eb.root;
+
+    while (node != NULL)
+    {
+        uint_t lsize = (node->left == NULL) ? 0 : node->left->sum_len;
+        uint_t lnl   = (node->left == NULL) ? 0 : node->left->sum_nl;
+
+        if (pos < start + lsize)
+        {
+            node = node->left;
+        }
+        else if (pos < start + lsize + node->len)
+        {
+            line += lnl + count_delims(node->text, pos - start - lsize);
+
+            break;
+        }
+        else
+        {
+            line  += lnl + node->nl;
+            start += lsize + node->len;
+            node   = node->right;
+        }
+    }
+
+    return line;
+}
+
+
+///
+///  @brief    Delete n chars relative to current position.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void delete_edit(int_t nbytes)
+{
+    if (nbytes == 0)
+    {
+        return;
+    }
+
+    if (eb.t.dot == 0 && nbytes == eb.t.Z)    // Killing entire buffer?
+    {
+        kill_edit();
+
+        return;
+    }
+
+    uint_t start = (uint_t)eb.t.dot;
+    bool backward = false;
+
+    if (nbytes < 0)                     // Deleting backwards
+    {
+        nbytes = -nbytes;
+        backward = true;
+
+        assert(nbytes <= eb.t.dot);
+
+        start -= (uint_t)nbytes;
+        eb.t.dot -= nbytes;             // Backwards delete affects dot
+    }
+    else
+    {
+        assert(nbytes <= eb.t.Z - eb.t.dot);
+    }
+
+    // Split the tree into the text before the deletion, the text being
+    // deleted, and the text after the deletion, and then rejoin the first
+    // and last parts.
+
+    struct node *left;
+    struct node *middle;
+    struct node *right;
+
+    split_tree(eb.root, start, &left, &right);
+    split_tree(right, (uint_t)nbytes, &middle, &right);
+
+    eb.t.nlines -= (int)middle->sum_nl;
+
+    if (backward)                       // Backwards delete affects line
+    {
+        eb.t.line -= (int)middle->sum_nl;
+    }
+
+    free_tree(middle);
+
+    eb.root  = join_tree(left, right);
+    eb.cache = NULL;
+    eb.t.Z  -= nbytes;
+
+    set_vars();
+
+    reset_ngrams();                     // Discard any search index
+    f.e0.window = true;                 // Window refresh needed
+}
+
+
+///
+///  @brief    Finish insertion into buffer.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void end_insert(uint_t nbytes, uint_t ndelims)
+{
+    assert(nbytes != 0);
+
+    eb.t.dot  += (int_t)nbytes;
+    eb.t.line += (int)ndelims;
+
+    set_vars();
+
+    if (eb.t.Z != 0 && page_count() == 0)
+    {
+        set_page(1);
+    }
+
+    reset_ngrams();                     // Discard any search index
+    f.e0.window = true;                 // Window refresh needed
+}
+
+
+///
+///  @brief    Clean up memory before we exit from TECO.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exit_edit(void)
+{
+    free_tree(eb.root);
+    free_spare();
+
+    eb.root  = NULL;
+    eb.cache = NULL;
+}
+
+
+///
+///  @brief    Find node containing absolute position, and make it the cached
+///            node. Since most reads are sequential, we first check the node
+///            used for the previous read before searching the tree.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void find_node(uint_t pos)
+{
+    assert(pos < (uint_t)eb.t.Z);
+
+    if (eb.cache != NULL && pos >= eb.start && pos < eb.start + eb.cache->len)
+    {
+        return;
+    }
+
+    struct node *node = eb.root;
+    uint_t start = 0;
+
+    for (;;)
+    {
+        assert(node != NULL);
+
+        uint_t lsize = (node->left == NULL) ? 0 : node->left->sum_len;
+
+        if (pos < start + lsize)
+        {
+            node = node->left;
+        }
+        else if (pos < start + lsize + node->len)
+        {
+            start += lsize;
+
+            break;
+        }
+        else
+        {
+            start += lsize + node->len;
+            node = node->right;
+        }
+    }
+
+    eb.cache = node;
+    eb.start = start;
+}
+
+
+///
+///  @brief    Free a node that is no longer in the tree. If the ED&512 flag
+///            bit is set, the node is kept for reuse by make_node() instead,
+///            just as the gap buffer keeps its memory after deletions.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void free_node(struct node *node)
+{
+    if (f.ed.noshrink)
+    {
+        node->left = eb.spare;
+        eb.spare   = node;
+    }
+    else
+    {
+        free_mem(&node);
+        free_spare();                   // Release anything we kept
+    }
+}
+
+
+///
+///  @brief    Free any nodes kept for reuse.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void free_spare(void)
+{
+    while (eb.spare != NULL)
+    {
+        struct node *node = eb.spare;
+
+        eb.spare = node->left;
+
+        free_mem(&node);
+    }
+}
+
+
+///
+///  @brief    Free all nodes in a tree.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void free_tree(struct node *node)
+{
+    while (node != NULL)
+    {
+        struct node *right = node->right;
+
+        free_tree(node->left);
+        free_node(node);
+
+        node = right;
+    }
+}
+
+
+///
+///  @brief    Initialize edit buffer. There is no memory to allocate until text
+///            is added, since the rest of the initialization for the 'eb' and
+///            't' structures is done statically, above.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void init_edit(void)
+{
+    assert(eb.root == NULL);            // Double initialization is an error
+
+    reset_edit();
+}
+
+
+///
+///  @brief    Try to insert text into an existing chunk that has enough room
+///            for it, updating the byte and delimiter counts of the chunk's
+///            ancestors as we unwind.
+///
+///  @returns  true if text was inserted, false if no chunk had room.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool insert_chunk(struct node *node, uint_t pos, const uchar *p,
+                         uint_t nbytes, uint_t ndelims)
+{
+    if (node == NULL)
+    {
+        return false;
+    }
+
+    uint_t lsize = (node->left == NULL) ? 0 : node->left->sum_len;
+    bool done;
+
+    if (pos < lsize)
+    {
+        done = insert_chunk(node->left, pos, p, nbytes, ndelims);
+    }
+    else if (pos <= lsize + node->len)
+    {
+        if (node->len + nbytes > CHUNK_SIZE)
+        {
+            return false;
+        }
+
+        uchar *q = node->text + pos - lsize;
+
+        memmove(q + nbytes, q, (size_t)(node->len - (pos - lsize)));
+        memcpy(q, p, (size_t)nbytes);
+
+        node->len += nbytes;
+        node->nl  += ndelims;
+
+        done = true;
+    }
+    else
+    {
+        done = insert_chunk(node->right, pos - lsize - node->len, p, nbytes,
+                            ndelims);
+    }
+
+    if (done)
+    {
+        node->sum_len += nbytes;
+        node->sum_nl  += ndelims;
+    }
+
+    return done;
+}
+
+
+///
+///  @brief    Insert string in edit buffer.
+///
+///  @returns  true if insert succeeded, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool insert_edit(const char *buf, size_t nbytes)
+{
+    assert(buf != NULL);
+
+    if (nbytes == 0)
+    {
+        return true;
+    }
+
+    if (!start_insert((uint_t)nbytes))
+    {
+        return false;
+    }
+
+    uint_t ndelims = insert_text((uint_t)eb.t.dot, (const uchar *)buf,
+                                 (uint_t)nbytes);
+
+    end_insert((uint_t)nbytes, ndelims);
+
+    return true;                        // Insertion was successful
+}
+
+
+///
+///  @brief    Insert text at an absolute position in the rope. If the text
+///            fits in the chunk containing the position, it is added there;
+///            otherwise, the tree is split at the position and new chunks are
+///            merged in between the two halves.
+///
+///  @returns  No. of delimiters in text.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t insert_text(uint_t pos, const uchar *p, uint_t nbytes)
+{
+    assert(p != NULL);
+    assert(nbytes != 0);
+
+    uint_t ndelims = count_delims(p, nbytes);
+
+    eb.cache     = NULL;
+    eb.t.Z      += (int_t)nbytes;
+    eb.t.nlines += (int)ndelims;
+
+    if (insert_chunk(eb.root, pos, p, nbytes, ndelims))
+    {
+        return ndelims;
+    }
+
+    struct node *left;
+    struct node *right;
+    struct node *middle = NULL;
+
+    split_tree(eb.root, pos, &left, &right);
+
+    while (nbytes != 0)
+    {
+        uint_t n = nbytes < CHUNK_SIZE ? nbytes : CHUNK_SIZE;
+
+        middle = merge_tree(middle, make_node(p, n));
+
+        p      += n;
+        nbytes -= n;
+    }
+
+    eb.root = merge_tree(join_tree(left, middle), right);
+
+    return ndelims;
+}
+
+
+///
+///  @brief    Join two trees, combining the last chunk of the left tree and
+///            the first chunk of the right tree if they fit in a single chunk.
+///            This keeps repeated deletions from fragmenting the rope.
+///
+///  @returns  Root of joined tree.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct node *join_tree(struct node *left, struct node *right)
+{
+    if (left == NULL || right == NULL)
+    {
+        return merge_tree(left, right);
+    }
+
+    struct node *last = left;
+    struct node *first = right;
+
+    while (last->right != NULL)
+    {
+        last = last->right;
+    }
+
+    while (first->left != NULL)
+    {
+        first = first->left;
+    }
+
+    if (last->len + first->len <= CHUNK_SIZE)
+    {
+        struct node *node;
+
+        split_tree(right, first->len, &node, &right);
+
+        assert(node == first);
+
+        (void)insert_chunk(left, left->sum_len, first->text, first->len,
+                           first->nl);
+
+        free_node(node);
+    }
+
+    return merge_tree(left, right);
+}
+
+
+///
+///  @brief    Kill the entire edit buffer.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void kill_edit(void)
+{
+    if (eb.t.Z != 0)                    // Anything in buffer?
+    {
+        free_tree(eb.root);
+
+        reset_edit();
+
+        reset_ngrams();                 // Discard any search index
+        f.e0.window = true;             // Window refresh needed
+    }
+}
+
+
+///
+///  @brief    Return number of bytes between dot and nth line terminator.
+///
+///  @returns  Number of characters relative to dot (can be plus or minus).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+int_t len_edit(int_t n)
+{
+    if (n > 0)
+    {
+        return next_line((uint_t)n) - eb.t.dot;
+    }
+    else
+    {
+        return prev_line((uint_t)-n) - eb.t.dot;
+    }
+}
+
+
+///
+///  @brief    Find the position following the nth delimiter in the buffer,
+///            (where n is 1 for the first delimiter).
+///
+///  @returns  Position following delimiter.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t line_start(uint_t n)
+{
+    assert(n > 0 && n <= (uint_t)eb.t.nlines);
+
+    struct node *node = eb.root;
+    uint_t pos = 0;
+
+    while (node != NULL)
+    {
+        uint_t lsize = (node->left == NULL) ? 0 : node->left->sum_len;
+        uint_t lnl   = (node->left == NULL) ? 0 : node->left->sum_nl;
+
+        if (n <= lnl)
+        {
+            node = node->left;
+
+            continue;
+        }
+
+        n   -= lnl;
+        pos += lsize;
+
+        if (n <= node->nl)
+        {
+            for (uint_t i = 0; i < node->len; ++i)
+            {
+                int c = node->text[i];
+
+                if (isdelim(c) && --n == 0)
+                {
+                    return pos + i + 1;
+                }
+            }
+
+            assert(false);              // Delimiter count is corrupted
+        }
+
+        n   -= node->nl;
+        pos += node->len;
+        node = node->right;
+    }
+
+    return pos;
+}
+
+
+///
+///  @brief    Create a new node containing a chunk of text.
+///
+///  @returns  New node.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct node *make_node(const uchar *p, uint_t nbytes)
+{
+    assert(nbytes <= CHUNK_SIZE);
+
+    struct node *node = eb.spare;
+
+    if (node != NULL)                   // Reuse a deleted node if we can
+    {
+        eb.spare = node->left;
+    }
+    else
+    {
+        node = alloc_mem((uint_t)sizeof(*node));
+    }
+
+    // Use a simple xorshift generator for node priorities.
+
+    eb.seed ^= eb.seed << 13;
+    eb.seed ^= eb.seed >> 17;
+    eb.seed ^= eb.seed << 5;
+
+    node->left  = node->right = NULL;
+    node->prio  = eb.seed;
+    node->len   = nbytes;
+    node->nl    = count_delims(p, nbytes);
+
+    memcpy(node->text, p, (size_t)nbytes);
+
+    update_node(node);
+
+    return node;
+}
+
+
+///
+///  @brief    Merge two trees, all of whose text in the left tree precedes the
+///            text in the right tree.
+///
+///  @returns  Root of merged tree.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct node *merge_tree(struct node *left, struct node *right)
+{
+    if (left == NULL)
+    {
+        return right;
+    }
+    else if (right == NULL)
+    {
+        return left;
+    }
+    else if (left->prio > right->prio)
+    {
+        left->right = merge_tree(left->right, right);
+
+        update_node(left);
+
+        return left;
+    }
+    else
+    {
+        right->left = merge_tree(left, right->left);
+
+        update_node(right);
+
+        return right;
+    }
+}
+
+
+///
+///  @brief    Move dot to a relative position.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void move_dot(int_t delta)
+{
+    set_dot(eb.t.dot + delta);
+}
+
+
+///
+///  @brief    Scan forward nlines in edit buffer.
+///
+///  @returns  Absolute position following line terminator.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int_t next_line(uint_t nlines)
+{
+    // Lines are usually short, so look for the end of the current line in
+    // the node containing dot before searching the tree.
+
+    if (nlines == 1 && eb.t.dot < eb.t.Z)
+    {
+        (void)read_pos((uint_t)eb.t.dot);
+
+        const uchar *p = eb.cache->text + (uint_t)eb.t.dot - eb.start;
+        const uchar *end = eb.cache->text + eb.cache->len;
+
+        while (p < end)
+        {
+            int c = *p++;
+
+            if (isdelim(c))
+            {
+                return (int_t)(eb.start + (uint_t)(p - eb.cache->text));
+            }
+        }
+    }
+
+    uint_t n = (uint_t)eb.t.line + nlines;
+
+    // If there aren't n lines following the current position, return Z.
+
+    if (n > (uint_t)eb.t.nlines)
+    {
+        return eb.t.Z;
+    }
+
+    return (int_t)line_start(n);
+}
+
+
+///
+///  @brief    Scan backward n lines in edit buffer.
+///
+///  @returns  Absolute position following line terminator (or 0 if none).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int_t prev_line(uint_t nlines)
+{
+    // Look for the start of the current line in the node preceding dot
+    // before searching the tree.
+
+    if (nlines == 0 && eb.t.dot > 0)
+    {
+        (void)read_pos((uint_t)eb.t.dot - 1);
+
+        const uchar *p = eb.cache->text + (uint_t)eb.t.dot - eb.start;
+
+        while (p > eb.cache->text)
+        {
+            int c = *--p;
+
+            if (isdelim(c))
+            {
+                return (int_t)(eb.start + (uint_t)(p - eb.cache->text) + 1);
+            }
+        }
+    }
+
+    // If there aren't n lines preceding the current position, return B.
+
+    if (nlines >= (uint_t)eb.t.line)
+    {
+        return 0;
+    }
+
+    return (int_t)line_start((uint_t)eb.t.line - nlines);
+}
+
+
+///
+///  @brief    Get ASCII value of nth character before or after dot.
+///
+///  @returns  ASCII value, or EOF if character outside of edit buffer.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+int read_edit(int_t pos)
+{
+    uint_t i = (uint_t)(eb.t.dot + pos); // Make relative position absolute
+
+    if (i < (uint_t)eb.t.Z)
+    {
+        return read_pos(i);
+    }
+
+    return EOF;
+}
+
+
+///
+///  @brief    Get ASCII value of character at absolute position.
+///
+///  @returns  ASCII value.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int read_pos(uint_t pos)
+{
+    assert(pos < (uint_t)eb.t.Z);
+
+    find_node(pos);
+
+    return eb.cache->text[pos - eb.start];
+}
+
+
+///
+///  @brief    Reset buffer variables to initial conditions.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void reset_edit(void)
+{
+    eb.root     = NULL;
+    eb.cache    = NULL;
+    eb.start    = 0;
+
+    eb.t.Z      = 0;
+    eb.t.dot    = 0;
+    eb.t.nextc  = EOF;
+    eb.t.c      = EOF;
+    eb.t.lastc  = EOF;
+    eb.t.len    = 0;
+    eb.t.pos    = 0;
+    eb.t.line   = 0;
+    eb.t.nlines = 0;
+}
+
+
+///
+///  @brief    Get contiguous span of text in edit buffer that ends before the
+///            specified position. Since this stops at the start of the chunk
+///            containing the end position, reading a range takes one call for
+///            each chunk it overlaps.
+///
+///  @returns  No. of bytes in span, or 0 if no text in range.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint_t rspan_edit(int_t start, int_t end, const uchar **text)
+{
+    assert(text != NULL);
+
+    start += eb.t.dot;                  // Make relative positions absolute
+    end   += eb.t.dot;
+
+    if (start < 0)
+    {
+        start = 0;
+    }
+
+    if (end > eb.t.Z || start >= end)
+    {
+        return 0;
+    }
+
+    find_node((uint_t)end - 1);
+
+    uint_t pos = (uint_t)start;
+
+    if (pos < eb.start)                 // Stop at start of chunk
+    {
+        pos = eb.start;
+    }
+
+    *text = eb.cache->text + (pos - eb.start);
+
+    return (uint_t)end - pos;
+}
+
+
+///
+///  @brief    Move dot to an absolute position.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void set_dot(int_t dot)
+{
+    if (dot < eb.t.B)
+    {
+        dot = eb.t.B;                   // Can't move before start of buffer
+    }
+    else if (dot > eb.t.Z)
+    {
+        dot = eb.t.Z;                   // Can't move after end of buffer
+    }
+
+    if (eb.t.dot == dot)
+    {
+        return;                         // Nothing to do if no change
+    }
+
+    // Here if position within edit buffer has changed.
+
+    f.e0.cursor = true;                 // Tell display to update cursor
+
+    int_t delta = dot - eb.t.dot;       // How much are we moving?
+
+    if (delta == 1 && !isdelim(eb.t.c)) // Moving forward within line?
+    {
+        ++eb.t.dot;
+        ++eb.t.pos;
+
+        eb.t.lastc = eb.t.c;
+        eb.t.c     = eb.t.nextc;
+        eb.t.nextc = read_edit(1);
+    }
+    else if (delta == -1 && !isdelim(eb.t.lastc)) // Backward within line?
+    {
+        --eb.t.dot;
+        --eb.t.pos;
+
+        eb.t.nextc = eb.t.c;
+        eb.t.c     = eb.t.lastc;
+        eb.t.lastc = read_edit(-1);
+    }
+    else
+    {
+        // Since the number of delimiters is kept for every subtree, we can
+        // always find the current line number, regardless of whether display
+        // mode is active.
+
+        eb.t.dot  = dot;
+        eb.t.line = (int)count_lines((uint_t)dot);
+
+        set_vars();
+    }
+}
+
+
+///
+///  @brief    Set public variables after dot or the buffer has changed. The
+///            current line number must already be correct.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void set_vars(void)
+{
+    eb.t.lastc = read_edit(-1);
+    eb.t.c     = read_edit(0);
+    eb.t.nextc = read_edit(1);
+
+    int_t prev = prev_line(0);          // Position of start of line
+
+    eb.t.pos = eb.t.dot - prev;
+    eb.t.len = next_line(1) - prev;
+}
+
+
+///
+///  @brief    Set memory size for edit buffer. Since the rope allocates its
+///            memory a chunk at a time, this is just the limit on how much
+///            text the buffer may hold.
+///
+///  @returns  New size, or 0 if size didn't change.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint_t size_edit(uint_t size)
+{
+    if (size > eb.max)
+    {
+        size = eb.max;
+    }
+    else if (size < eb.min)
+    {
+        size = eb.min;
+    }
+
+    uint_t runt = size & (KB - 1);
+
+    if (runt != 0)                      // Partial kilobyte?
+    {
+        size += KB - runt;              // Yes, round up to next kilobyte
+    }
+
+    if (size < eb.t.size)               // Shrinking buffer?
+    {
+        free_spare();                   // Yes, release any nodes we kept
+    }
+
+    // Return if size is the same as, or is smaller than, the edit buffer.
+
+    if (size == eb.t.size || size <= (uint_t)eb.t.Z)
+    {
+        return 0;
+    }
+
+    eb.t.size = size;
+
+    return size;
+}
+
+
+///
+///  @brief    Get contiguous span of text in edit buffer. Since this stops at
+///            the end of the chunk containing the start position, reading a
+///            range takes one call for each chunk it overlaps.
+///
+///  @returns  No. of bytes in span, or 0 if no text in range.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint_t span_edit(int_t start, int_t end, const uchar **text)
+{
+    assert(text != NULL);
+
+    start += eb.t.dot;                  // Make relative positions absolute
+    end   += eb.t.dot;
+
+    if (end > eb.t.Z)
+    {
+        end = eb.t.Z;
+    }
+
+    if (start < 0 || start >= end)
+    {
+        return 0;
+    }
+
+    uint_t pos = (uint_t)start;
+
+    find_node(pos);
+
+    uint_t offset = pos - eb.start;
+    uint_t nbytes = eb.cache->len - offset;
+
+    if (nbytes > (uint_t)(end - start))
+    {
+        nbytes = (uint_t)(end - start);
+    }
+
+    *text = eb.cache->text + offset;
+
+    return nbytes;
+}
+
+
+///
+///  @brief    Split tree into two trees, the first of which contains the
+///            specified number of bytes. If the split position is in the
+///            middle of a chunk, that chunk is divided into two nodes.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void split_tree(struct node *node, uint_t pos, struct node **left,
+                       struct node **right)
+{
+    assert(left != NULL);
+    assert(right != NULL);
+
+    if (node == NULL)
+    {
+        *left = *right = NULL;
+
+        return;
+    }
+
+    uint_t lsize = (node->left == NULL) ? 0 : node->left->sum_len;
+
+    if (pos <= lsize)
+    {
+        split_tree(node->left, pos, left, &node->left);
+        update_node(node);
+
+        *right = node;
+    }
+    else if (pos >= lsize + node->len)
+    {
+        split_tree(node->right, pos - lsize - node->len, &node->right, right);
+        update_node(node);
+
+        *left = node;
+    }
+    else                                // Split is inside this chunk
+    {
+        uint_t offset = pos - lsize;
+        struct node *tail = make_node(node->text + offset, node->len - offset);
+
+        node->len  = offset;
+        node->nl  -= tail->nl;
+
+        *right = merge_tree(tail, node->right);
+
+        node->right = NULL;
+
+        update_node(node);
+
+        *left = node;
+    }
+}
+
+
+///
+///  @brief    Verify that there is room in buffer for text to be inserted.
+///
+///  @returns  true if there is room, false if there isn't.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool start_insert(uint_t nbytes)
+{
+    // Make sure data can fit in the space we have. If not, increase by 50%.
+
+    while (eb.t.size - (uint_t)eb.t.Z < nbytes)
+    {
+        uint_t size = (eb.t.size * 3) / 2;
+
+        if (size_edit(size) == 0)
+        {
+            return false;
+        }
+
+        print_size(size);
+    }
+
+    return true;
+}
+
+
+///
+///  @brief    Recalculate subtree totals for node.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void update_node(struct node *node)
+{
+    assert(node != NULL);
+
+    node->sum_len = node->len;
+    node->sum_nl  = node->nl;
+
+    if (node->left != NULL)
+    {
+        node->sum_len += node->left->sum_len;
+        node->sum_nl  += node->left->sum_nl;
+    }
+
+    if (node->right != NULL)
+    {
+        node->sum_len += node->right->sum_len;
+        node->sum_nl  += node->right->sum_nl;
+    }
+}
@@ -79,7 +79,9 @@ static void exec_search(struct cmd *cmd, bool replace)
 {
     assert(cmd != NULL);
 
-    if (cmd->n_set && cmd->n_arg == 0)  // 0Stext` isn't allowed
+    bool all = (cmd->n_set && cmd->n_arg == 0);
+
+    if (all && (!replace || cmd->dcolon)) // Only 0FS is allowed
     {
         throw(E_ISA);                   // Invalid search argument
     }
@@ -184,7 +186,24 @@ static void exec_search(struct cmd *cmd, bool replace)
         }
     }
 
-    if (search_loop(&s))
+    if (all)                            // 0FSold`new` => replace all
+    {
+        uint_t count = replace_all(&s, cmd->text2.data, cmd->text2.len);
+
+        if (count == 0)
+        {
+            search_failure(cmd, cmd->m_set ? true : f.ed.keepdot);
+        }
+        else if (cmd->colon)
+        {
+            store_val((int_t)count);
+        }
+        else
+        {
+            search_success(cmd);
+        }
+    }
+    else if (search_loop(&s))
     {
         if (replace)
         {
@@ -26,9 +26,19 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#if     defined(THREADS)
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#endif
+
 #include "teco.h"
 #include "ascii.h"
 #include "editbuf.h"
@@ -42,363 +52,2302 @@
 #include "search.h"
 
 
-///   @var    last_search
-///   @brief  Last string searched for
+/// @def    addset(m, c)
+/// @brief  Add character to set for compiled search element.
+
+#define addset(m, c) \
+    ((m)->set[(c) / CHAR_BIT] |= (uchar)(1u << ((c) % CHAR_BIT)))
+
+/// @def    inset(m, c)
+/// @brief  Check to see if character is in set for compiled search element.
+
+#define inset(m, c) ((m)->set[(c) / CHAR_BIT] & (1u << ((c) % CHAR_BIT)))
+
+#define DFA_ELEMENTS    32              ///< Max. elements in string for DFA
+
+#define DFA_MEM         (1 * MB)        ///< Max. memory used for DFA states
+
+#define DFA_DEAD        (-1)            ///< NFA thread failed to match
+
+#define DFA_AFTER       (-2)            ///< Match ends after current chr.
+
+#define DFA_BEFORE      (-3)            ///< Match ends before current chr.
+
+#define SCAN_CHUNK      (1 * MB)        ///< Max. bytes searched by one thread
+
+#define SCAN_MATCHES    8192            ///< Max. matches saved by one thread
+
+#define SCAN_THREADS    64              ///< Max. threads used for a search
+
+#define SCAN_SPARSE     256             ///< Min. bytes per index candidate
+
+///  @enum   match_type
+///  @brief  Type of compiled search element.
+
+enum match_type
+{
+    MATCH_SET,                          ///< Match one character in set
+    MATCH_BLANKS,                       ///< Match one or more blanks (^ES)
+    MATCH_ERROR                         ///< Invalid element (error if reached)
+};
+
+///  @struct  match
+///  @brief   Compiled element of search string. Each element matches a single
+///           character (or a run of blanks), as specified by a 256-bit map.
+
+struct match
+{
+    enum match_type type;               ///< Type of element
+    uchar set[(UCHAR_MAX + 1) / CHAR_BIT]; ///< Bitmap of matching characters
+    uint nchrs;                         ///< No. of characters in set
+    int chr;                            ///< Only char. in set (or EOF)
+    int fold;                           ///< Folded char. for set (or EOF)
+    int error;                          ///< Error code for MATCH_ERROR
+    int qname;                          ///< Q-register name for E_IQN
+};
+
+///  @struct  program
+///  @brief   Compiled search string.
+
+struct program
+{
+    struct match *match;                ///< Compiled elements
+    uint_t size;                        ///< Allocated no. of elements
+    uint_t count;                       ///< No. of elements used
+    bool valid;                         ///< true if compiled string is current
+    int ctrl_x;                         ///< CTRL/X flag when compiled
+    bool qreg;                          ///< true if string uses ^EGq
+    bool negate;                        ///< true if string starts with ^N
+    bool literal;                       ///< true if literal string
+    uint_t shift[UCHAR_MAX + 1];        ///< Shifts for literal search
+    uint_t rshift[UCHAR_MAX + 1];       ///< Shifts for reverse literal search
+};
+
+///  @struct  dstate
+///  @brief   State of the DFA used for forward searches. Each state is an
+///           ordered list of NFA threads, each of which is a partial match
+///           for a different starting position, with the earliest start first.
+///           Thread 2i is waiting for element i of the compiled search string,
+///           and thread 2i+1 is in the middle of a run of blanks for element i.
+
+struct dstate
+{
+    bool matched;                       ///< true if match already found
+    uint nthreads;                      ///< No. of NFA threads
+    uchar thread[DFA_ELEMENTS * 2];     ///< NFA threads
+};
+
+///  @struct  dfa
+///  @brief   DFA built lazily from the compiled search string, as each state
+///           and transition is needed.
+
+struct dfa
+{
+    struct dstate *state;               ///< DFA states
+    int *next;                          ///< Next state for each class, or -1
+    uchar *accept;                      ///< Match ended by each transition
+    uint_t size;                        ///< Allocated no. of states
+    uint_t count;                       ///< No. of states used
+    uint nclasses;                      ///< No. of character classes
+    uchar class[UCHAR_MAX + 1];         ///< Character class for each chr.
+    uchar chr[UCHAR_MAX + 1];           ///< First chr. in each class
+    bool valid;                         ///< true if DFA is current
+    bool failed;                        ///< true if DFA used too much memory
+};
+
+///  @struct  chunk
+///  @brief   Part of the edit buffer searched by one thread. Matches must start
+///           before the end of the chunk, but may extend past it as far as the
+///           end of the contiguous text that contains the chunk.
+
+struct chunk
+{
+    const uchar *text;                  ///< Text at start of chunk
+    int_t start;                        ///< Start of chunk relative to dot
+    int_t end;                          ///< End of chunk relative to dot
+    int_t limit;                        ///< End of contiguous text
+    int_t stop;                         ///< Where search of chunk stopped
+    bool full;                          ///< true if no room for more matches
+    uint_t count;                       ///< No. of matches found
+    int_t match[SCAN_MATCHES][2];       ///< Start and end of each match
+};
+
+///  @struct  scan
+///  @brief   State of a search that is split across multiple threads.
+
+struct scan
+{
+    struct chunk *chunk;                ///< Chunks in current batch
+    uint_t size;                        ///< Allocated no. of chunks
+    uint_t nchunks;                     ///< No. of chunks in current batch
+    uint_t next;                        ///< Current chunk
+    uint_t index;                       ///< Next match in current chunk
+    int_t text_end;                     ///< End search at this position
+    int_t Z;                            ///< End of buffer relative to dot
+    bool movedot;                       ///< Next search starts after match
+};
+
+#if     defined(THREADS)
+
+///  @struct  pool
+///  @brief   Worker threads that search chunks for split searches. These are
+///           started when first needed, and then wait for each new batch, so
+///           that we don't create and destroy threads for every batch. Each
+///           thread (including the main one) takes the next chunk that no
+///           other thread has taken, until there are none left.
+
+struct pool
+{
+    pthread_t thread[SCAN_THREADS];     ///< Worker threads
+    uint_t nworkers;                    ///< No. of worker threads started
+    pthread_mutex_t lock;               ///< Lock for pool and chunks
+    pthread_cond_t start;               ///< Signaled when batch starts
+    pthread_cond_t done;                ///< Signaled when batch is done
+    uint_t batch;                       ///< Current batch no.
+    uint_t next;                        ///< Next chunk to search
+    uint_t pending;                     ///< No. of chunks not yet searched
+    bool quit;                          ///< true if workers should exit
+    bool forked;                        ///< true if fork handler registered
+};
+
+#endif
+
+///   @var    last_search
+///   @brief  Last string searched for
+
+tstring last_search = { .len = 0 };
+
+///   @var    program
+///   @brief  Compiled version of last search string
+
+static struct program program = { .match = NULL, .size = 0, .count = 0 };
+
+///   @var    replace_buf
+///   @brief  Buffer for new text built by replace_all()
+
+static tbuffer replace_buf = { .data = NULL, .size = 0, .len = 0 };
+
+///   @var    dfa
+///   @brief  DFA for compiled search string
+
+static struct dfa dfa = { .state = NULL, .size = 0, .valid = false };
+
+///   @var    page_buf
+///   @brief  Buffer for pages read by skip_pages()
+
+static tbuffer page_buf = { .data = NULL, .size = 0, .len = 0 };
+
+///   @var    scan
+///   @brief  Search split across multiple threads
+
+static struct scan scan = { .chunk = NULL, .size = 0 };
+
+#if     defined(THREADS)
+
+///   @var    pool
+///   @brief  Worker threads for split searches
+
+static struct pool pool =
+{
+    .nworkers = 0,
+    .lock     = PTHREAD_MUTEX_INITIALIZER,
+    .start    = PTHREAD_COND_INITIALIZER,
+    .done     = PTHREAD_COND_INITIALIZER,
+    .batch    = 0,
+    .quit     = false,
+    .forked   = false,
+};
+
+#endif
+
+// Local functions
+
+static void add_text(const char *p, uint_t nbytes);
+
+static bool begin_scan(struct search *s, bool movedot);
+
+static bool check_page(const uchar *text, uint_t nbytes);
+
+static uint_t compile_chr(const uchar *p, uint_t len, struct match *m);
+
+static void compile_search(void);
+
+static void copy_text(int_t start, int_t end);
+
+static bool dfa_add(int from, uint class);
+
+static void dfa_build(void);
+
+static int dfa_search(struct search *s, int_t *start);
+
+static int_t dfa_start(struct search *s, int_t end);
+
+static int dfa_step(uint thread, uint c);
+
+static const uchar *find_first(const uchar *text, uint_t nbytes);
+
+static uint_t find_literal(const uchar *text, uint_t last);
+
+static bool find_trigram(uint_t *offset, const uint_t **list, uint_t *count);
+
+static int isctrlx(int c, int match);
+
+static int issymbol(int c);
+
+static int match_chunk(const struct chunk *c, int_t pos, int_t *end);
+
+static bool match_str(struct search *s);
+
+static uint_t next_ngram(const uint_t *list, uint_t count, uint_t pos);
+
+static bool next_scan(struct search *s);
+
+static bool read_page(struct ifile *ifile, uint_t max);
+
+static void rskip_literal(struct search *s);
+
+#if     defined(THREADS)
+
+static void reset_workers(void);
+
+#endif
+
+static void rskip_search(struct search *s);
+
+static void run_batch(int_t pos);
+
+static void scan_chunk(struct chunk *c);
+
+#if     defined(THREADS)
+
+static void scan_chunks(void);
+
+static void *scan_thread(void *arg);
+
+#endif
+
+static uint_t scan_threads(void);
+
+static void skip_literal(struct search *s);
+
+static bool skip_pages(struct ifile *ifile, FILE *fp);
+
+static void skip_search(struct search *s);
+
+#if     defined(THREADS)
+
+static void start_workers(uint_t nworkers);
+
+static void stop_workers(void);
+
+#endif
+
+
+///
+///  @brief    Add text to the buffer used by replace_all(), expanding it as
+///            needed.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void add_text(const char *p, uint_t nbytes)
+{
+    if (nbytes == 0)
+    {
+        return;
+    }
+
+    tbuffer *buf = &replace_buf;
+
+    if (buf->data == NULL)
+    {
+        *buf = alloc_tbuf(nbytes < KB ? KB : nbytes);
+    }
+    else if (buf->len + nbytes > buf->size)
+    {
+        uint_t size = buf->size * 2;
+
+        if (size < buf->len + nbytes)
+        {
+            size = buf->len + nbytes;
+        }
+
+        buf->data = expand_mem(buf->data, buf->size, size - buf->size);
+        buf->size = size;
+    }
+
+    memcpy(buf->data + buf->len, p, (size_t)nbytes);
+
+    buf->len += nbytes;
+}
+
+
+///
+///  @brief    Decide whether a forward search through the edit buffer should
+///            be split across multiple threads, and if so, set up the search.
+///            This is only worthwhile if the buffer is large, and it is only
+///            possible if the search string can't cause an error, since the
+///            threads can't throw exceptions.
+///
+///  @returns  true if search is split, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool begin_scan(struct search *s, bool movedot)
+{
+    assert(s != NULL);                  // Error if no search block
+
+    if (s->search != search_forward || s->type == SEARCH_C
+        || last_search.data == NULL || program.count == 0
+        || s->text_end - s->text_start < (int_t)(2 * SCAN_CHUNK))
+    {
+        return false;
+    }
+
+    for (uint_t i = 0; i < program.count; ++i)
+    {
+        if (program.match[i].type == MATCH_ERROR)
+        {
+            return false;
+        }
+    }
+
+    uint_t offset, count;
+    const uint_t *list;
+
+    // A search index is only faster than a split search if the trigram it
+    // uses is rare enough that most of the buffer can be skipped.
+
+    if (find_trigram(&offset, &list, &count)
+        && count < (uint_t)(s->text_end - s->text_start) / SCAN_SPARSE)
+    {
+        return false;
+    }
+
+    uint_t nthreads = scan_threads();
+
+    if (nthreads < 2)
+    {
+        return false;
+    }
+
+    if (scan.size != nthreads)
+    {
+        free_mem(&scan.chunk);
+
+        scan.chunk = alloc_mem(nthreads * (uint_t)sizeof(struct chunk));
+        scan.size  = nthreads;
+    }
+
+    scan.nchunks  = scan.next = scan.index = 0;
+    scan.text_end = s->text_end;
+    scan.Z        = t->Z - t->dot;
+    scan.movedot  = movedot;
+
+    return true;
+}
+
+
+///
+///  @brief    Build a search string, allocating storage for it.
+///
+///  @returns  TECO string.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void build_search(const char *src, uint_t len)
+{
+    tstring tmp = build_string(src, len);
+
+    last_len = 0;                       // Assume search will fail
+
+    // If we're searching for the same string as last time (as in a loop),
+    // then keep the compiled string we already have.
+
+    if (last_search.data != NULL && tmp.len == last_search.len
+        && !memcmp(tmp.data, last_search.data, (size_t)tmp.len))
+    {
+        return;
+    }
+
+    program.valid = false;              // Force recompilation
+
+    free_mem(&last_search.data);
+
+    last_search.data = alloc_mem(tmp.len + 1);
+    last_search.len = tmp.len;
+
+    strcpy(last_search.data, tmp.data);
+}
+
+
+///
+///  @brief    Check whether a page read from the input file could contain a
+///            match for the compiled search string. This only has to reject
+///            pages that can't contain a match; anything else is loaded into
+///            the edit buffer and searched in the usual way.
+///
+///  @returns  true if page could contain a match, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool check_page(const uchar *text, uint_t nbytes)
+{
+    if (program.count == 0 || program.negate
+        || program.match[0].type == MATCH_ERROR)
+    {
+        return true;
+    }
+    else if (program.literal)
+    {
+        if (nbytes < program.count)
+        {
+            return false;
+        }
+
+        uint_t last = nbytes - program.count;
+
+        return (find_literal(text, last) <= last);
+    }
+    else
+    {
+        return (find_first(text, nbytes) != NULL);
+    }
+}
+
+
+///
+///  @brief    Compile the next element of a search string, allowing for the
+///            use of match control constructs. Any error found is stored in
+///            the element, so that it is only reported if the search reaches
+///            that element.
+///
+///  @returns  No. of characters used from search string.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t compile_chr(const uchar *p, uint_t len, struct match *m)
+{
+    assert(p != NULL);
+    assert(len != 0);
+    assert(m != NULL);
+
+    uint_t n = 0;
+    int match = p[n++];
+
+    memset(m, 0, sizeof(*m));
+
+    m->type = MATCH_SET;
+
+    if (match == CTRL_E)
+    {
+        if (n == len)
+        {
+            m->type  = MATCH_ERROR;
+            m->error = E_ISS;           // Invalid search string
+
+            return n;
+        }
+
+        match = toupper(p[n++]);
+
+        if (match == 'G')               // ^EGq matches chr. in Q-register q
+        {
+            program.qreg = true;        // Recompile for every search
+
+            bool qlocal = false;
+            int qname;
+
+            if (n == len)
+            {
+                m->type  = MATCH_ERROR;
+                m->error = E_MQN;       // Missing Q-register name
+
+                return n;
+            }
+
+            if ((qname = p[n++]) == '.')
+            {
+                qlocal = true;
+
+                if (n == len)
+                {
+                    m->type  = MATCH_ERROR;
+                    m->error = E_MQN;   // Missing Q-register name
+
+                    return n;
+                }
+
+                qname = p[n++];
+            }
+
+            int qindex = get_qindex(qname, qlocal);
+
+            if (qindex == -1)
+            {
+                m->type  = MATCH_ERROR;
+                m->error = E_IQN;       // Invalid Q-register name
+                m->qname = qname;
+
+                return n;
+            }
+
+            struct qreg *qreg = get_qreg(qindex);
+
+            for (uint_t i = 0; i < qreg->text.len; ++i)
+            {
+                uint c = (uchar)qreg->text.data[i];
+
+                addset(m, c);
+            }
+
+            return n;
+        }
+        else if (strchr("ABCDLRSVWX", match) != NULL)
+        {
+            if (match == 'S')
+            {
+                m->type = MATCH_BLANKS;
+            }
+
+            for (uint c = 0; c <= UCHAR_MAX; ++c)
+            {
+                if ((match == 'A' && isalpha(c))  ||
+                    (match == 'B' && !isalnum(c)) ||
+                    (match == 'C' && issymbol(c)) ||
+                    (match == 'D' && isdigit(c))  ||
+                    (match == 'L' && isdelim(c))  ||
+                    (match == 'R' && isalnum(c))  ||
+                    (match == 'S' && isblank(c))  ||
+                    (match == 'V' && islower(c))  ||
+                    (match == 'W' && isupper(c))  ||
+                    (match == 'X'))
+                {
+                    addset(m, c);
+                }
+            }
+
+            return n;
+        }
+
+        // <CTRL/E>nnn matches character whose decimal value is nnn.
+
+        if (match >= '0' && match <= '9')
+        {
+            uint c = (uint)(match - '0');
+
+            // Loop until we run out of decimal digits
+
+            while (n < len && isdigit(p[n]))
+            {
+                if (c <= UCHAR_MAX)     // Stop once it can't match anything
+                {
+                    c *= 10;            // Shift digit over
+                    c += (uint)(p[n] - '0'); // Add in new digit
+                }
+
+                ++n;
+            }
+
+            if (c <= UCHAR_MAX)
+            {
+                addset(m, c);
+            }
+
+            return n;
+        }
+
+        m->type  = MATCH_ERROR;
+        m->error = E_ICE;               // Invalid ^E command in search argument
+    }
+    else if (match == CTRL_N)           // ^N^N doesn't make sense
+    {
+        m->type  = MATCH_ERROR;
+        m->error = E_ISS;               // Invalid search string
+    }
+    else
+    {
+        for (uint c = 0; c <= UCHAR_MAX; ++c)
+        {
+            if ((match == CTRL_S && !isalnum(c))  ||
+                match == CTRL_X                   ||
+                isctrlx((int)c, match)            ||
+                (int)c == match)
+            {
+                addset(m, c);
+            }
+        }
+    }
+
+    return n;
+}
+
+
+///
+///  @brief    Compile the last search string into a list of elements, each of
+///            which has a bitmap of the characters it matches, with any case
+///            folding already applied. This is checked at the start of each
+///            search command, since the string may be reused after the CTRL/X
+///            flag or the contents of a Q-register used with ^EGq has changed.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void compile_search(void)
+{
+    if (program.valid && program.ctrl_x == f.ctrl_x && !program.qreg)
+    {
+        return;                         // Nothing has changed since last time
+    }
+
+    const uchar *p = (const uchar *)last_search.data;
+    uint_t len = last_search.len;
+
+    program.valid   = true;
+    program.ctrl_x  = f.ctrl_x;
+    dfa.valid       = false;
+    program.qreg    = false;
+    program.count   = 0;
+    program.negate  = false;
+    program.literal = false;
+
+    if (p == NULL)
+    {
+        return;
+    }
+
+    if (program.size < len)
+    {
+        free_mem(&program.match);
+
+        program.match = alloc_mem(len * (uint_t)sizeof(struct match));
+        program.size  = len;
+    }
+
+    if (len != 0 && *p == CTRL_N)       // ^N inverts sense of whole string
+    {
+        program.negate = true;
+
+        ++p;
+        --len;
+    }
+
+    while (len != 0)
+    {
+        struct match *m = &program.match[program.count++];
+        uint_t n = compile_chr(p, len, m);
+
+        p   += n;
+        len -= n;
+
+        // See if there is only a single character in the set, which lets us
+        // use memchr() to skip ahead to candidate positions.
+
+        m->nchrs = 0;
+        m->chr   = EOF;
+
+        for (uint c = 0; c <= UCHAR_MAX && m->type != MATCH_ERROR; ++c)
+        {
+            if (inset(m, c) && m->nchrs++ == 0)
+            {
+                m->chr = (int)c;
+            }
+        }
+
+        if (m->nchrs != 1)
+        {
+            m->chr = EOF;
+        }
+
+        // See if every character in the set folds to the same character,
+        // which lets us use the search index (if any).
+
+        m->fold = EOF;
+
+        for (uint c = 0; c <= UCHAR_MAX && m->type == MATCH_SET; ++c)
+        {
+            if (!inset(m, c))
+            {
+                continue;
+            }
+            else if (m->fold == EOF)
+            {
+                m->fold = (int)fold_ngram(c);
+            }
+            else if (m->fold != (int)fold_ngram(c))
+            {
+                m->fold = EOF;
+
+                break;
+            }
+        }
+
+        if (m->type == MATCH_ERROR)     // Nothing after error can be reached
+        {
+            break;
+        }
+    }
+
+    // If every element matches one character, or one of a pair of characters
+    // differing only in case, then we can use the Boyer-Moore-Horspool
+    // algorithm to skip over text that can't contain a match. The shift for
+    // each character is the distance from the last element of the string to
+    // the last earlier element that matches the character. For backward
+    // searches, the shift is the distance from the first element to the first
+    // later element that matches the character.
+
+    program.literal = (!program.negate && program.count >= 2);
+
+    for (uint_t i = 0; i < program.count && program.literal; ++i)
+    {
+        const struct match *m = &program.match[i];
+
+        if (m->type != MATCH_SET || m->nchrs > 2)
+        {
+            program.literal = false;
+        }
+    }
+
+    if (program.literal)
+    {
+        for (uint c = 0; c <= UCHAR_MAX; ++c)
+        {
+            program.shift[c] = program.count;
+        }
+
+        for (uint_t i = 0; i < program.count - 1; ++i)
+        {
+            const struct match *m = &program.match[i];
+
+            for (uint c = 0; c <= UCHAR_MAX; ++c)
+            {
+                if (inset(m, c))
+                {
+                    program.shift[c] = program.count - 1 - i;
+                }
+            }
+        }
+
+        for (uint c = 0; c <= UCHAR_MAX; ++c)
+        {
+            program.rshift[c] = program.count;
+        }
+
+        for (uint_t i = program.count - 1; i != 0; --i)
+        {
+            const struct match *m = &program.match[i];
+
+            for (uint c = 0; c <= UCHAR_MAX; ++c)
+            {
+                if (inset(m, c))
+                {
+                    program.rshift[c] = i;
+                }
+            }
+        }
+    }
+}
+
+
+///
+///  @brief    Copy text from the edit buffer to the buffer used by
+///            replace_all(). The positions are relative to dot.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void copy_text(int_t start, int_t end)
+{
+    const uchar *text;
+    uint_t nbytes;
+
+    while ((nbytes = span_edit(start, end, &text)) != 0)
+    {
+        add_text((const char *)text, nbytes);
+
+        start += (int_t)nbytes;
+    }
+}
+
+
+///
+///  @brief    Count every occurrence of the search string that starts in the
+///            range to be searched. Occurrences do not overlap, so the search
+///            for each one starts at the end of the previous one, as it does
+///            for replace_all().
+///
+///  @returns  No. of occurrences found.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint_t count_search(struct search *s)
+{
+    assert(s != NULL);                  // Error if no search block
+    assert(s->search == search_forward);
+
+    compile_search();
+
+    uint_t count = 0;
+    bool split = begin_scan(s, (bool)false);
+
+    while (split ? next_scan(s) : search_forward(s))
+    {
+        int_t start = s->match_start;
+        int_t last = s->text_pos;
+
+        s->text_start = (last > start) ? last : start + 1;
+
+        ++count;
+    }
+
+    return count;
+}
+
+
+///
+///  @brief    Add a transition to the DFA, creating a new state if needed.
+///
+///  @returns  true if transition added, false if we ran out of memory.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool dfa_add(int from, uint class)
+{
+    struct dstate new = { .matched = dfa.state[from].matched, .nthreads = 0 };
+    const struct dstate *old = &dfa.state[from];
+    uint c = dfa.chr[class];
+    uchar accept = 0;                   // 1 if match ends before c, 2 if after
+
+    // Step each thread in order. If one of them reaches the end of the search
+    // string, then it matches at an earlier position than any thread after
+    // it, so we drop those, and keep only the earlier ones that might still
+    // find a match of their own.
+
+    for (uint i = 0; i < old->nthreads; ++i)
+    {
+        int next = dfa_step(old->thread[i], c);
+
+        if (next == DFA_AFTER || next == DFA_BEFORE)
+        {
+            accept = (next == DFA_AFTER) ? 2 : 1;
+            new.matched = true;
+
+            break;
+        }
+        else if (next != DFA_DEAD
+                 && memchr(new.thread, next, (size_t)new.nthreads) == NULL)
+        {
+            new.thread[new.nthreads++] = (uchar)next;
+        }
+    }
+
+    // Unless we have already found a match, start a new thread at the next
+    // character.
+
+    if (!new.matched && memchr(new.thread, 0, (size_t)new.nthreads) == NULL)
+    {
+        new.thread[new.nthreads++] = 0;
+    }
+
+    uint_t to;
+
+    for (to = 0; to < dfa.count; ++to)
+    {
+        const struct dstate *state = &dfa.state[to];
+
+        if (state->matched == new.matched && state->nthreads == new.nthreads
+            && !memcmp(state->thread, new.thread, (size_t)new.nthreads))
+        {
+            break;
+        }
+    }
+
+    if (to == dfa.count)                // Need a new state?
+    {
+        if (dfa.count == dfa.size)
+        {
+            uint_t size = dfa.size * 2;
+            uint_t nbytes = (uint_t)sizeof(struct dstate)
+                          + dfa.nclasses * (uint_t)(sizeof(int) + 1);
+
+            if (size * nbytes > DFA_MEM)
+            {
+                dfa.failed = true;
+
+                return false;
+            }
+
+            dfa.state  = expand_mem(dfa.state,
+                                    dfa.size * (uint_t)sizeof(struct dstate),
+                                    dfa.size * (uint_t)sizeof(struct dstate));
+            dfa.next   = expand_mem(dfa.next,
+                                    dfa.size * dfa.nclasses
+                                    * (uint_t)sizeof(int),
+                                    dfa.size * dfa.nclasses
+                                    * (uint_t)sizeof(int));
+            dfa.accept = expand_mem(dfa.accept, dfa.size * dfa.nclasses,
+                                    dfa.size * dfa.nclasses);
+            dfa.size   = size;
+        }
+
+        dfa.state[dfa.count++] = new;
+
+        for (uint i = 0; i < dfa.nclasses; ++i)
+        {
+            dfa.next[to * dfa.nclasses + i] = -1;
+        }
+    }
+
+    dfa.next[(uint_t)from * dfa.nclasses + class]   = (int)to;
+    dfa.accept[(uint_t)from * dfa.nclasses + class] = accept;
+
+    return true;
+}
+
+
+///
+///  @brief    Set up the DFA for the compiled search string. Characters that
+///            are treated the same way by every element of the string share a
+///            class, so that each state only needs a transition for each
+///            class. The initial state has just the thread for a match
+///            starting at the first character.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void dfa_build(void)
+{
+    uint64_t key[UCHAR_MAX + 1];
+
+    dfa.nclasses = 0;
+
+    for (uint c = 0; c <= UCHAR_MAX; ++c)
+    {
+        uint64_t bits = isblank(c) ? (1uLL << DFA_ELEMENTS) : 0;
+
+        for (uint_t i = 0; i < program.count; ++i)
+        {
+            if (inset(&program.match[i], c))
+            {
+                bits |= 1uLL << i;
+            }
+        }
+
+        uint class = 0;
+
+        while (class < dfa.nclasses && key[class] != bits)
+        {
+            ++class;
+        }
+
+        if (class == dfa.nclasses)
+        {
+            key[dfa.nclasses]   = bits;
+            dfa.chr[dfa.nclasses++] = (uchar)c;
+        }
+
+        dfa.class[c] = (uchar)class;
+    }
+
+    free_mem(&dfa.state);
+    free_mem(&dfa.next);
+    free_mem(&dfa.accept);
+
+    dfa.size   = 16;
+    dfa.state  = alloc_mem(dfa.size * (uint_t)sizeof(struct dstate));
+    dfa.next   = alloc_mem(dfa.size * dfa.nclasses * (uint_t)sizeof(int));
+    dfa.accept = alloc_mem(dfa.size * dfa.nclasses);
+    dfa.count  = 1;
+    dfa.valid  = true;
+    dfa.failed = false;
+
+    dfa.state[0].matched   = false;
+    dfa.state[0].nthreads  = 1;
+    dfa.state[0].thread[0] = 0;
+
+    for (uint i = 0; i < dfa.nclasses; ++i)
+    {
+        dfa.next[i] = -1;
+    }
+}
+
+
+///
+///  @brief    Use the DFA to find the first position at which the compiled
+///            search string matches, reading each character of the edit
+///            buffer once. When the DFA finds where that match ends, we then
+///            go back to find where it starts. The DFA is only used if the
+///            string has no errors, is not negated, and can be searched up
+///            to the end of the buffer; and we give up if it needs too much
+///            memory.
+///
+///  @returns  1 if match found, 0 if no match, -1 if DFA can't be used.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int dfa_search(struct search *s, int_t *start)
+{
+    assert(s != NULL);                  // Error if no search block
+    assert(start != NULL);
+
+    int_t Z = t->Z - t->dot;
+
+    if (program.negate || program.count > DFA_ELEMENTS || s->text_end != Z
+        || (dfa.valid && dfa.failed))
+    {
+        return -1;
+    }
+
+    for (uint_t i = 0; i < program.count; ++i)
+    {
+        if (program.match[i].type == MATCH_ERROR)
+        {
+            return -1;
+        }
+    }
+
+    if (!dfa.valid)
+    {
+        dfa_build();
+    }
+
+    const uchar *text;
+    uint_t nbytes;
+    int_t pos = s->text_start;
+    int_t end = -1;                     // End of match (if found)
+    int state = 0;
+
+    while ((nbytes = span_edit(pos, Z, &text)) != 0)
+    {
+        for (uint_t i = 0; i < nbytes; ++i)
+        {
+            if (state == 0)             // Skip to next possible match
+            {
+                const uchar *p = find_first(text + i, nbytes - i);
+
+                if (p == NULL)
+                {
+                    break;
+                }
+
+                i = (uint_t)(p - text);
+            }
+
+            uint_t n = (uint_t)state * dfa.nclasses + dfa.class[text[i]];
+
+            if (dfa.next[n] == -1 && !dfa_add(state, dfa.class[text[i]]))
+            {
+                return -1;
+            }
+
+            if (dfa.accept[n] != 0)     // Did a thread reach end of string?
+            {
+                end = pos + (int_t)i + dfa.accept[n] - 1;
+            }
+
+            state = dfa.next[n];
+
+            if (dfa.state[state].nthreads == 0) // Any threads left?
+            {
+                *start = dfa_start(s, end);
+
+                return 1;
+            }
+        }
+
+        pos += (int_t)nbytes;
+    }
+
+    // At the end of the buffer, a thread that is in a run of blanks for the
+    // last element matches, and all threads ahead of it fail.
+
+    const struct dstate *last = &dfa.state[state];
+    uint thread = (uint)(program.count - 1) * 2 + 1;
+
+    if (memchr(last->thread, (int)thread, (size_t)last->nthreads) != NULL)
+    {
+        end = Z;
+    }
+
+    if (end == -1)
+    {
+        return 0;
+    }
+
+    *start = dfa_start(s, end);
+
+    return 1;
+}
+
+
+///
+///  @brief    Find the start of the first match for the compiled search
+///            string, given where it ends. We go backward from the end,
+///            keeping track of each element that could match each character,
+///            and stop when nothing more can match. The match starts at the
+///            last position at which we reached the first element.
+///
+///            Since a run of blanks is always as long as possible, the element
+///            after one can't match a blank.
+///
+///  @returns  Start of match.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int_t dfa_start(struct search *s, int_t end)
+{
+    assert(s != NULL);                  // Error if no search block
+
+    const struct match *match = program.match;
+    uint64_t done = 1uLL << program.count; // Elements left to match
+    uint64_t runs = 0;                     // Runs of blanks in progress
+    int_t start = end;
+
+    for (int_t pos = end - 1; pos >= s->text_start && (done | runs); --pos)
+    {
+        uint c = (uint)read_edit(pos);
+        uint64_t next_done = 0;
+        uint64_t next_runs = 0;
+
+        for (uint_t i = 1; i <= program.count; ++i)
+        {
+            const struct match *m = &match[i - 1];
+
+            if ((done & (1uLL << i)) && inset(m, c)
+                && !(i >= 2 && match[i - 2].type == MATCH_BLANKS
+                     && isblank(c)))
+            {
+                next_done |= 1uLL << (i - 1);
+
+                if (m->type == MATCH_BLANKS)
+                {
+                    next_runs |= 1uLL << (i - 1);
+                }
+            }
+
+            if ((runs & (1uLL << (i - 1))) && isblank(c))
+            {
+                next_done |= 1uLL << (i - 1);
+                next_runs |= 1uLL << (i - 1);
+            }
+        }
+
+        if (next_done & 1)              // Reached first element?
+        {
+            start = pos;
+        }
+
+        done = next_done & ~1uLL;
+        runs = next_runs;
+    }
+
+    return start;
+}
+
+
+///
+///  @brief    Step an NFA thread for the DFA.
+///
+///  @returns  Next thread, or DFA_DEAD, DFA_AFTER, or DFA_BEFORE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int dfa_step(uint thread, uint c)
+{
+    uint_t i = thread / 2;
+    const struct match *m = &program.match[i];
+
+    if (thread % 2 != 0)                // In a run of blanks?
+    {
+        if (isblank(c))
+        {
+            return (int)thread;
+        }
+        else if (++i == program.count)
+        {
+            return DFA_BEFORE;
+        }
+
+        m = &program.match[i];          // End of run, so try next element
+    }
+
+    if (!inset(m, c))
+    {
+        return DFA_DEAD;
+    }
+    else if (m->type == MATCH_BLANKS)
+    {
+        return (int)(i * 2 + 1);
+    }
+    else if (i + 1 == program.count)
+    {
+        return DFA_AFTER;
+    }
+    else
+    {
+        return (int)((i + 1) * 2);
+    }
+}
+
+
+///
+///  @brief    Find the first character in a block of text that matches the
+///            first element of the compiled search string.
+///
+///  @returns  Pointer to character, or NULL if not found.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static const uchar *find_first(const uchar *text, uint_t nbytes)
+{
+    const struct match *m = &program.match[0];
+
+    if (m->chr != EOF)
+    {
+        return memchr(text, m->chr, (size_t)nbytes);
+    }
+
+    for (uint_t i = 0; i < nbytes; ++i)
+    {
+        uint c = text[i];
+
+        if (inset(m, c))
+        {
+            return text + i;
+        }
+    }
+
+    return NULL;
+}
+
+
+///
+///  @brief    Find the first position in a block of text at which a literal
+///            search string matches, using the Boyer-Moore-Horspool algorithm.
+///            The caller ensures that the string fits in the text at every
+///            position up to and including the last one we check.
+///
+///  @returns  Position of match, or a value greater than last if not found.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t find_literal(const uchar *text, uint_t last)
+{
+    const struct match *match = program.match;
+    uint_t len = program.count;
+    uint_t i = 0;
+
+    while (i <= last)
+    {
+        uint c = text[i + len - 1];
+
+        if (inset(&match[len - 1], c))
+        {
+            uint_t j = len - 1;
+
+            while (j != 0 && inset(&match[j - 1], (uint)text[i + j - 1]))
+            {
+                --j;
+            }
+
+            if (j == 0)
+            {
+                break;                  // Found a match
+            }
+        }
+
+        i += program.shift[c];
+    }
+
+    return i;
+}
+
+
+///
+///  @brief    Find the trigram in a literal search string that has the fewest
+///            candidate positions in the search index.
+///
+///  @returns  true if trigram found, false if there is no search index, or if
+///            the search string has no trigram we can use.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool find_trigram(uint_t *offset, const uint_t **list, uint_t *count)
+{
+    assert(offset != NULL);
+    assert(list != NULL);
+    assert(count != NULL);
+
+    bool found = false;
+
+    for (uint_t i = 0; program.literal && i + 3 <= program.count; ++i)
+    {
+        const struct match *m = &program.match[i];
+
+        if (m[0].fold == EOF || m[1].fold == EOF || m[2].fold == EOF)
+        {
+            continue;
+        }
+
+        uint key = ((uint)m[0].fold << (CHAR_BIT * 2))
+                 | ((uint)m[1].fold << CHAR_BIT) | (uint)m[2].fold;
+        uint_t n;
+        const uint_t *p = find_ngrams(key, &n);
+
+        if (p == NULL)                  // No search index
+        {
+            return false;
+        }
+        else if (!found || n < *count)
+        {
+            found   = true;
+            *offset = i;
+            *list   = p;
+            *count  = n;
+        }
+    }
+
+    return found;
+}
+
+
+///
+///  @brief    Check for case-insensitive match, depending on the setting of
+///            the CTRL/X flag:
+///
+///             1: Case-insensitive match.
+///
+///             0: Old case-insensitive match. Not only matches alphabetic
+///                characters, but additionally the following pairs.
+///
+///                @ (64) and ` (96)
+///                [ (91) and { (123)
+///                | (92) and \ (124)
+///                ] (93) and } (125)
+///                ^ (94) and ~ (126)
+///
+///            -1: Case-sensitive match.
+///
+///            Note that we return 1/0 instead of true/false for compatibility
+///            with the ANSI isxxx() functions.
+///
+///  @returns  1 if a match found, else 0.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int isctrlx(int c, int match)
+{
+    if (f.ctrl_x != -1)
+    {
+        c     = toupper(c);
+        match = toupper(match);
+
+        if (!isalpha(c) && f.ctrl_x == 0)
+        {
+            if (strchr("`{|}~", c) != NULL)
+            {
+                c -= 'a' - 'A';
+            }
+
+            if (strchr("`{|}~", match) != NULL)
+            {
+                match -= 'a' - 'A';
+            }
+        }
+    }
+
+    return (c == match) ? 1 : 0;
+}
+
+
+///
+///  @brief    Check for a match on a symbol constituent: alphanumeric, period,
+///            dollar sign and underscore.
+///
+///            Note that we return 1/0 instead of true/false for compatibility
+///            with the ANSI isxxx() library functions.
+///
+///  @returns  1 if a match found, else 0.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int issymbol(int c)
+{
+    if (isalnum(c) || c == '.' || c == '$' || c == '_')
+    {
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+
+///
+///  @brief    Check to see if text in a chunk matches the compiled search
+///            string. This works the same way as match_str(), except that it
+///            doesn't touch the edit buffer or throw exceptions, so that it
+///            can be called by any thread.
+///
+///  @returns  1 if match (end will contain the end of the match), 0 if no
+///            match, or -1 if we need text past the end of the chunk's text.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int match_chunk(const struct chunk *c, int_t pos, int_t *end)
+{
+    const struct match *m = program.match;
+    const struct match *last = m + program.count;
+
+    for (; m < last; ++m)
+    {
+        if (pos >= c->limit)
+        {
+            return (c->limit == scan.Z) ? 0 : -1;
+        }
+
+        uint ch = c->text[pos++ - c->start];
+
+        if (!inset(m, ch))
+        {
+            if (!program.negate)
+            {
+                return 0;
+            }
+
+            *end = pos;
+
+            return 1;
+        }
+        else if (m->type == MATCH_BLANKS) // Skip any additional blanks
+        {
+            for (; pos < scan.text_end; ++pos)
+            {
+                if (pos >= c->limit)
+                {
+                    return -1;
+                }
+                else if (!isblank(c->text[pos - c->start]))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    if (program.negate)
+    {
+        return 0;
+    }
+
+    *end = pos;
+
+    return 1;
+}
+
+
+///
+///  @brief    Check to see if text string matches compiled search string.
+///
+///  @returns  true if match, else false (unless the first character is CTRL/N,
+///            if which case we return false if it's a match, otherwise true).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool match_str(struct search *s)
+{
+    assert(s != NULL);                  // Error if no search block
+
+    const struct match *m = program.match;
+    const struct match *end = m + program.count;
+
+    // Get as much of the text to be matched as is contiguous in the edit
+    // buffer, so that we only need to call read_edit() if we go past it.
+
+    const uchar *text;
+    int_t base = s->text_pos;
+    uint_t nbytes = span_edit(base, t->Z - t->dot, &text);
+
+    for (; m < end; ++m)
+    {
+        uint_t i = (uint_t)(s->text_pos++ - base);
+        int c = (i < nbytes) ? text[i] : read_edit(s->text_pos - 1);
+
+        if (c == EOF)
+        {
+            return false;
+        }
+        else if (m->type == MATCH_ERROR)
+        {
+            if (m->error == E_IQN)
+            {
+                throw(E_IQN, m->qname); // Invalid Q-register name
+            }
+
+            throw(m->error);
+        }
+        else if (!inset(m, c))
+        {
+            return program.negate;
+        }
+        else if (m->type == MATCH_BLANKS) // Skip any additional blanks
+        {
+            while (s->text_pos < s->text_end)
+            {
+                if ((c = read_edit(s->text_pos++)) == EOF)
+                {
+                    break;
+                }
+                else if (!isblank(c))
+                {
+                    --s->text_pos;
+
+                    break;
+                }
+            }
+        }
+    }
+
+    return !program.negate;
+}
+
+
+///
+///  @brief    Find the first position in a list of candidates from the search
+///            index that is at or after a specified position.
+///
+///  @returns  Index of position in list, or count if there is none.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t next_ngram(const uint_t *list, uint_t count, uint_t pos)
+{
+    uint_t low = 0;
+    uint_t high = count;
+
+    while (low < high)
+    {
+        uint_t mid = low + (high - low) / 2;
+
+        if (list[mid] < pos)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+
+///
+///  @brief    Get the next match for a search that is split across multiple
+///            threads. We go through the matches found by the threads in
+///            order, but since each thread started at the beginning of its
+///            chunk, a match that ends inside a later chunk can leave us at a
+///            position that thread skipped over. In that case, or if a thread
+///            stopped early, we check each position ourselves until we get
+///            back in step with the thread.
+///
+///  @returns  true if string found (text_pos will contain the buffer position
+///            relative to dot), and false if not found.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool next_scan(struct search *s)
+{
+    assert(s != NULL);                  // Error if no search block
+
+    int_t pos = s->text_start;
 
-tstring last_search = { .len = 0 };
+    while (pos < scan.text_end)
+    {
+        if (scan.next == scan.nchunks)  // Need a new batch of chunks?
+        {
+            run_batch(pos);
+        }
 
-// Local functions
+        struct chunk *c = &scan.chunk[scan.next];
 
-static int isblankx(int c, struct search *s);
+        if (pos >= c->end)              // Done with this chunk?
+        {
+            ++scan.next;
+            scan.index = 0;
 
-static int isctrlx(int c, int match);
+            continue;
+        }
+        else if (pos < c->stop)
+        {
+            while (scan.index < c->count && c->match[scan.index][0] < pos)
+            {
+                ++scan.index;
+            }
 
-static int isqreg(int c, struct search *s);
+            // We're in step with the thread unless we're inside one of the
+            // matches it found (which can't happen if movedot is set, since
+            // then the thread checked every position).
 
-static int issymbol(int c);
+            if (scan.movedot || scan.index == 0
+                || c->match[scan.index - 1][1] <= pos)
+            {
+                if (scan.index == c->count)
+                {
+                    pos = c->stop;      // No more matches before stop
+
+                    continue;
+                }
 
-static bool match_chr(int c, struct search *s);
+                int_t *match = c->match[scan.index++];
 
-static bool match_str(struct search *s);
+                s->match_start = match[0];
+                s->text_pos    = match[1];
+                s->text_start  = scan.movedot ? match[0] + 1 : match[1];
+
+                return true;
+            }
+        }
+        else if (c->full)               // Thread ran out of room for matches
+        {
+            c->stop = pos;              // So search rest of chunk here
+            scan.index = 0;
+
+            scan_chunk(c);
+
+            continue;
+        }
+
+        s->text_pos   = pos;
+        s->text_start = pos + 1;
+
+        if (match_str(s))
+        {
+            s->match_start = pos;
+
+            if (!scan.movedot)
+            {
+                s->text_start = s->text_pos;
+            }
+
+            return true;
+        }
+
+        ++pos;
+    }
+
+    s->text_start = pos;
+
+    return false;
+}
 
 
 ///
-///  @brief    Build a search string, allocating storage for it.
+///  @brief    Replace every occurrence of the search string that starts in
+///            the range to be searched. Instead of moving the gap to each
+///            match in turn, deleting it, and inserting the new text, we make
+///            a single pass through the buffer, copying the unmatched text and
+///            the new text to a separate buffer. Then the old text is replaced
+///            by the new text all at once, and dot is left at the end of the
+///            last replacement.
 ///
-///  @returns  TECO string.
+///  @returns  No. of replacements made.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-void build_search(const char *src, uint_t len)
+uint_t replace_all(struct search *s, const char *text, uint_t len)
 {
-    tstring tmp = build_string(src, len);
+    assert(s != NULL);                  // Error if no search block
+    assert(s->search == search_forward);
+    assert(text != NULL || len == 0);
 
-    last_len = 0;                       // Assume search will fail
+    compile_search();
 
-    free_mem(&last_search.data);
+    uint_t count = 0;
+    int_t last = 0;                     // End of last match
 
-    last_search.data = alloc_mem(tmp.len + 1);
-    last_search.len = tmp.len;
+    replace_buf.len = 0;
 
-    strcpy(last_search.data, tmp.data);
+    bool split = begin_scan(s, (bool)false);
+
+    while (split ? next_scan(s) : search_forward(s))
+    {
+        int_t start = s->match_start;
+
+        copy_text(last, start);
+        add_text(text, len);
+
+        last = s->text_pos;
+        s->text_start = (last > start) ? last : start + 1;
+
+        ++count;
+    }
+
+    if (count != 0)
+    {
+        // Insert the new text before deleting the old, so that if we run
+        // out of memory, the edit buffer is left unchanged.
+
+        if (replace_buf.len != 0
+            && !insert_edit(replace_buf.data, (size_t)replace_buf.len))
+        {
+            free_mem(&replace_buf.data);
+
+            throw(E_MEM);               // Memory overflow
+        }
+
+        delete_edit(last);
+    }
+
+    free_mem(&replace_buf.data);
+
+    replace_buf.size = replace_buf.len = 0;
+
+    last_len = len;                     // Same as last insertion
+
+    return count;
 }
 
 
 ///
-///  @brief    Check for multiple blanks (spaces or tabs) at current position.
-///
-///            Note that we return 1/0 instead of true/false for compatibility
-///            with the ANSI isxxx() functions.
+///  @brief    Read the next page from the input file into the page buffer,
+///            as append_edit() would read it into the edit buffer. We stop if
+///            the page would exceed the specified size.
 ///
-///  @returns  1 if one or more blanks found, else 0.
+///  @returns  true if we stopped before the end of the page, else false.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static int isblankx(int c, struct search *s)
+static bool read_page(struct ifile *ifile, uint_t max)
 {
-    assert(s != NULL);                  // Error if no search block
+    assert(ifile != NULL);
+
+    tbuffer *buf = &page_buf;
 
-    if (!isblank(c))
+    if (buf->data == NULL)
     {
-        return 0;
+        *buf = alloc_tbuf(max < 64 * KB ? max : 64 * KB);
     }
 
-    while (s->text_pos < s->text_end)
+    buf->len = 0;
+
+    for (;;)
     {
-        if ((c = read_edit(s->text_pos++)) == EOF)
+        uint_t nbytes = buf->size - buf->len;
+        bool more = read_input(ifile, (uchar *)buf->data + buf->len, &nbytes,
+                               (bool)false);
+
+        buf->len += nbytes;
+
+        if (!more)
         {
-            break;
+            return false;
         }
-        else if (!isblank(c))
+        else if (buf->size >= max)
         {
-            --s->text_pos;
+            return true;
+        }
 
-            break;
+        uint_t size = buf->size * 2;
+
+        if (size > max)
+        {
+            size = max;
         }
-    }
 
-    return 1;
+        buf->data = expand_mem(buf->data, buf->size, size - buf->size);
+        buf->size = size;
+    }
 }
 
 
 ///
-///  @brief    Check for case-insensitive match, depending on the setting of
-///            the CTRL/X flag:
+///  @brief    Deallocate memory for last search.
 ///
-///             1: Case-insensitive match.
+///  @returns  Nothing.
 ///
-///             0: Old case-insensitive match. Not only matches alphabetic
-///                characters, but additionally the following pairs.
+////////////////////////////////////////////////////////////////////////////////
+
+void reset_search(void)
+{
+#if     defined(THREADS)
+
+    stop_workers();                     // Workers may use the chunks
+
+#endif
+
+    free_mem(&last_search.data);
+    free_mem(&program.match);
+    free_mem(&replace_buf.data);
+    free_mem(&page_buf.data);
+    free_mem(&scan.chunk);
+    free_mem(&dfa.state);
+    free_mem(&dfa.next);
+    free_mem(&dfa.accept);
+
+    reset_ngrams();
+
+    dfa.size      = dfa.count = 0;
+    dfa.valid     = false;
+    page_buf.size = page_buf.len = 0;
+    scan.size     = 0;
+    program.size  = program.count = 0;
+    program.valid = false;
+}
+
+
+#if     defined(THREADS)
+
 ///
-///                @ (64) and ` (96)
-///                [ (91) and { (123)
-///                | (92) and \ (124)
-///                ] (93) and } (125)
-///                ^ (94) and ~ (126)
+///  @brief    Forget about worker threads in a child process created by
+///            fork(), since only the thread that called fork() exists there.
 ///
-///            -1: Case-sensitive match.
+///  @returns  Nothing.
 ///
-///            Note that we return 1/0 instead of true/false for compatibility
-///            with the ANSI isxxx() functions.
+////////////////////////////////////////////////////////////////////////////////
+
+static void reset_workers(void)
+{
+    (void)pthread_mutex_init(&pool.lock, NULL);
+    (void)pthread_cond_init(&pool.start, NULL);
+    (void)pthread_cond_init(&pool.done, NULL);
+
+    pool.nworkers = 0;
+}
+
+#endif
+
+
 ///
-///  @returns  1 if a match found, else 0.
+///  @brief    Skip back to the previous position in the edit buffer at which a
+///            literal search string matches, using the reverse of the Boyer-
+///            Moore-Horspool algorithm used by skip_literal(). If the text to
+///            be compared at the current position is not contiguous, we leave
+///            it to match_str(). If there is a search index, we use that
+///            instead to go back to the previous candidate.
+///
+///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static int isctrlx(int c, int match)
+static void rskip_literal(struct search *s)
 {
-    if (f.ctrl_x != -1)
+    assert(s != NULL);                  // Error if no search block
+
+    uint_t offset, count;
+    const uint_t *list;
+
+    if (find_trigram(&offset, &list, &count))
     {
-        c     = toupper(c);
-        match = toupper(match);
+        // Go back to the last candidate at or before the current position.
 
-        if (!isalpha(c) && f.ctrl_x == 0)
+        uint_t pos = (uint_t)(t->dot + s->text_start) + offset;
+        uint_t i = next_ngram(list, count, pos + 1);
+        int_t start = s->text_end - 1;
+
+        if (i != 0)
         {
-            if (strchr("`{|}~", c) != NULL)
+            start = (int_t)list[i - 1] - (int_t)offset - t->dot;
+        }
+
+        s->text_start = (start >= s->text_end) ? start : s->text_end - 1;
+
+        return;
+    }
+
+    const struct match *match = program.match;
+    uint_t len = program.count;
+    int_t end = s->text_start + (int_t)len;
+
+    if (end > t->Z - t->dot)            // Can't match past end of buffer
+    {
+        return;
+    }
+
+    const uchar *text;
+    uint_t nbytes = rspan_edit(s->text_end, end, &text);
+
+    if (nbytes < len)
+    {
+        return;
+    }
+
+    // Compare the first character first, since that's the one that determines
+    // how far back we can shift if there's no match.
+
+    int_t first = (int_t)(nbytes - len);
+    int_t i = first;
+
+    while (i >= 0)
+    {
+        uint c = text[i];
+
+        if (inset(&match[0], c))
+        {
+            uint_t j = 1;
+
+            while (j < len && inset(&match[j], (uint)text[i + (int_t)j]))
             {
-                c -= 'a' - 'A';
+                ++j;
             }
 
-            if (strchr("`{|}~", match) != NULL)
+            if (j == len)
             {
-                match -= 'a' - 'A';
+                break;                  // Found a match
             }
         }
+
+        i -= (int_t)program.rshift[c];
     }
 
-    return (c == match) ? 1 : 0;
+    s->text_start -= first - i;
 }
 
 
 ///
-///  @brief    Check for a match with one of the characters in a Q-register.
-///
-///            Note that we return 1/0 instead of true/false for compatibility
-///            with the ANSI isxxx() functions.
+///  @brief    Skip back to the previous position in the edit buffer that
+///            matches the first element of the compiled search string. This
+///            is the reverse of skip_search().
 ///
-///  @returns  1 if a match found, else 0.
+///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static int isqreg(int c, struct search *s)
+static void rskip_search(struct search *s)
 {
     assert(s != NULL);                  // Error if no search block
 
-    int qname;
-    bool qlocal = false;
-
-    if (s->match_len-- == 0)
+    if (program.literal)
     {
-        throw(E_MQN);                   // Missing Q-register name
-    }
+        rskip_literal(s);
 
-    if ((qname = *s->match_buf++) == '.')
+        return;
+    }
+    else if (program.count == 0 || program.negate)
     {
-        qlocal = true;
-
-        if (s->match_len-- == 0)
-        {
-            throw(E_MQN);               // Missing Q-register name
-        }
-
-        qname = *s->match_buf++;
+        return;
     }
 
-    int qindex = get_qindex(qname, qlocal);
+    const struct match *m = &program.match[0];
 
-    if (qindex == -1)
+    if (m->type == MATCH_ERROR)
     {
-        throw(E_IQN, qname);            // Invalid Q-register name
+        return;
     }
 
-    struct qreg *qreg = get_qreg(qindex);
+    const uchar *text;
+    uint_t nbytes;
 
-    for (uint_t i = 0; i < qreg->text.len; ++i)
+    while ((nbytes = rspan_edit(s->text_end, s->text_start + 1, &text)) != 0)
     {
-        if (c == qreg->text.data[i])
+        const uchar *p = text + nbytes;
+
+        // There's no portable equivalent of memchr() for searching backward,
+        // so just check each character in turn.
+
+        if (m->chr != EOF)
         {
-            return 1;
+            while (p > text && p[-1] != m->chr)
+            {
+                --p;
+            }
+        }
+        else
+        {
+            while (p > text && !inset(m, (uint)p[-1]))
+            {
+                --p;
+            }
+        }
+
+        if (p != text)
+        {
+            s->text_start -= (int_t)(text + nbytes - p);
+
+            return;
         }
-    }
 
-    return 0;
+        s->text_start -= (int_t)nbytes;
+    }
 }
 
 
 ///
-///  @brief    Check for a match on a symbol constituent: alphanumeric, period,
-///            dollar sign and underscore.
-///
-///            Note that we return 1/0 instead of true/false for compatibility
-///            with the ANSI isxxx() library functions.
+///  @brief    Split the next part of the edit buffer into chunks, one for
+///            each thread, and search them. Each chunk is limited to text that
+///            is contiguous in the edit buffer.
 ///
-///  @returns  1 if a match found, else 0.
+///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static int issymbol(int c)
+static void run_batch(int_t pos)
 {
-    if (isalnum(c) || c == '.' || c == '$' || c == '_')
+    scan.nchunks = scan.next = scan.index = 0;
+
+    while (scan.nchunks < scan.size && pos < scan.text_end)
     {
-        return 1;
+        struct chunk *c = &scan.chunk[scan.nchunks++];
+        const uchar *text;
+        uint_t nbytes = span_edit(pos, scan.Z, &text);
+
+        assert(nbytes != 0);
+
+        c->text  = text;
+        c->start = c->stop = pos;
+        c->limit = pos + (int_t)nbytes;
+        c->end   = c->limit;
+
+        if (c->end > pos + (int_t)SCAN_CHUNK)
+        {
+            c->end = pos + (int_t)SCAN_CHUNK;
+        }
+
+        if (c->end > scan.text_end)
+        {
+            c->end = scan.text_end;
+        }
+
+        pos = c->end;
     }
-    else
+
+#if     defined(THREADS)
+
+    start_workers(scan.nchunks - 1);
+
+    (void)pthread_mutex_lock(&pool.lock);
+
+    pool.next    = 0;
+    pool.pending = scan.nchunks;
+    ++pool.batch;
+
+    (void)pthread_cond_broadcast(&pool.start);
+
+    scan_chunks();                      // Help the workers
+
+    while (pool.pending != 0)
     {
-        return 0;
+        (void)pthread_cond_wait(&pool.done, &pool.lock);
+    }
+
+    (void)pthread_mutex_unlock(&pool.lock);
+
+#else
+
+    for (uint_t i = 0; i < scan.nchunks; ++i)
+    {
+        scan_chunk(&scan.chunk[i]);
     }
+
+#endif
 }
 
 
 ///
-///  @brief    Check for a match on the current character in the edit buffer,
-///            allowing for the use of match control constructs in the search
-///            string. Note that we can be called recursively.
+///  @brief    Search a chunk of the edit buffer for matches, starting where
+///            the last search of the chunk stopped. This can be called by any
+///            thread, and works the same way as search_forward(). We stop
+///            early if we run out of room to save matches, or if we need to
+///            check text that is not contiguous with the chunk.
 ///
-///  @returns  true if a match found, else false.
+///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static bool match_chr(int c, struct search *s)
+static void scan_chunk(struct chunk *c)
 {
-    assert(s != NULL);                  // Error if no search block
+    assert(c != NULL);
+
+    int_t pos = c->stop;
+    int_t end;
+
+    c->count = 0;
+    c->full  = false;
+
+    while (pos < c->end)
+    {
+        if (program.literal)            // Skip to next candidate
+        {
+            int_t len = (int_t)program.count;
+
+            if (c->limit - pos < len)
+            {
+                if (c->limit != scan.Z)
+                {
+                    c->stop = pos;      // Match may continue past chunk
+
+                    return;
+                }
+
+                break;                  // Too close to end of buffer
+            }
+
+            int_t last = c->limit - len;
+
+            if (last >= c->end)
+            {
+                last = c->end - 1;
+            }
+
+            pos += (int_t)find_literal(c->text + (pos - c->start),
+                                       (uint_t)(last - pos));
+
+            if (pos > last)
+            {
+                continue;
+            }
+        }
+        else if (!program.negate)
+        {
+            const uchar *p = find_first(c->text + (pos - c->start),
+                                        (uint_t)(c->end - pos));
+
+            if (p == NULL)
+            {
+                break;
+            }
 
-    if (s->match_len-- == 0)
-    {
-        throw(E_ISS);                   // Invalid search string
-    }
+            pos = c->start + (int_t)(p - c->text);
+        }
 
-    int match = *s->match_buf++;
+        int result = match_chunk(c, pos, &end);
 
-    if (match == CTRL_E)
-    {
-        if (s->match_len-- == 0)
+        if (result < 0 || (result > 0 && c->count == SCAN_MATCHES))
         {
-            throw(E_ISS);               // Invalid search string
+            c->stop = pos;
+            c->full = (result > 0);
+
+            return;
         }
+        else if (result > 0)
+        {
+            c->match[c->count][0] = pos;
+            c->match[c->count][1] = end;
 
-        match = toupper(*s->match_buf++);
+            ++c->count;
 
-        if ((match == 'A' && isalpha(c))     ||
-            (match == 'B' && !isalnum(c))    ||
-            (match == 'C' && issymbol(c))    ||
-            (match == 'D' && isdigit(c))     ||
-            (match == 'G' && isqreg(c, s))   ||
-            (match == 'L' && isdelim(c))     ||
-            (match == 'R' && isalnum(c))     ||
-            (match == 'S' && isblankx(c, s)) ||
-            (match == 'V' && islower(c))     ||
-            (match == 'W' && isupper(c))     ||
-            (match == 'X'))
-        {
-            return true;
+            pos = scan.movedot ? pos + 1 : end;
         }
-        else if (strchr("ABCDGLRSVWX", match) != NULL)
+        else
         {
-            return false;               // Valid match chr., but no match
+            ++pos;
         }
+    }
 
-        // <CTRL/E>nnn matches character whose decimal value is nnn.
+    c->stop = c->end;
+}
 
-        if (match >= '0' && match <= '9')
-        {
-            int n = match - '0';
 
-            // Loop until we run out of decimal digits
+#if     defined(THREADS)
 
-            while (s->match_len > 0)
-            {
-                if (!isdigit(*s->match_buf))
-                {
-                    break;
-                }
+///
+///  @brief    Search chunks in the current batch until there are none left.
+///            This must be called with the pool locked.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-                --s->match_len;
+static void scan_chunks(void)
+{
+    while (pool.next < scan.nchunks)
+    {
+        struct chunk *c = &scan.chunk[pool.next++];
 
-                n *= 10;                // Shift digit over
-                n += *s->match_buf++ - '0'; // Add in new digit
-            }
+        (void)pthread_mutex_unlock(&pool.lock);
 
-            return (c == n) ? true : false;
-        }
+        scan_chunk(c);
 
-        throw(E_ICE);                   // Invalid ^E command in search argument
-    }
-    else if (match == CTRL_N)           // ^N^N doesn't make sense
-    {
-        throw(E_ISS);                   // Invalid search string
-    }
-    else if ((match == CTRL_S && !isalnum(c)) ||
-             match == CTRL_X                  ||
-             isctrlx(c, match)                ||
-             c == match)
-    {
-        return true;
-    }
+        (void)pthread_mutex_lock(&pool.lock);
 
-    return false;
+        if (--pool.pending == 0)
+        {
+            (void)pthread_cond_signal(&pool.done);
+        }
+    }
 }
 
 
 ///
-///  @brief    Check to see if text string matches search string.
+///  @brief    Start routine for worker threads, which wait for each batch of
+///            chunks and help search them, until told to exit.
 ///
-///  @returns  true if match, else false (unless the first character is CTRL/N,
-///            if which case we return false if it's a match, otherwise true).
+///  @returns  NULL.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static bool match_str(struct search *s)
+static void *scan_thread(void *arg)
 {
-    assert(s != NULL);                  // Error if no search block
+    (void)pthread_mutex_lock(&pool.lock);
 
-    if (*s->match_buf == CTRL_N && s->match_len > 0)
-    {
-        --s->match_len;
-        ++s->match_buf;
+    uint_t batch = pool.batch;
 
-        while (s->match_len > 0)
+    for (;;)
+    {
+        while (pool.batch == batch && !pool.quit)
         {
-            int c = read_edit(s->text_pos++);
-
-            if (c == EOF)
-            {
-                return false;
-            }
-            else if (!match_chr(c, s))
-            {
-                return true;
-            }
+            (void)pthread_cond_wait(&pool.start, &pool.lock);
         }
 
-        return false;
-    }
-    else
-    {
-        while (s->match_len > 0)
+        if (pool.quit)
         {
-            int c = read_edit(s->text_pos++);
-
-            if (c == EOF || !match_chr(c, s))
-            {
-                return false;
-            }
+            break;
         }
 
-        return true;
+        batch = pool.batch;
+
+        scan_chunks();
     }
+
+    (void)pthread_mutex_unlock(&pool.lock);
+
+    return arg;
 }
 
+#endif
+
 
 ///
-///  @brief    Deallocate memory for last search.
+///  @brief    Get the no. of threads to use for searches, as specified by the
+///            E5 flag. If the flag is 0, we use one thread per processor.
 ///
-///  @returns  Nothing.
+///  @returns  No. of threads.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-void reset_search(void)
+static uint_t scan_threads(void)
 {
-    free_mem(&last_search.data);
+#if     defined(THREADS)
+
+    long nthreads = f.e5;
+
+    if (nthreads == 0)
+    {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    if (nthreads < 1)
+    {
+        return 1;
+    }
+    else if (nthreads > SCAN_THREADS)
+    {
+        return SCAN_THREADS;
+    }
+
+    return (uint_t)nthreads;
+
+#else
+
+    return 1;
+
+#endif
 }
 
 
@@ -422,16 +2371,27 @@ bool search_backward(struct search *s)
 
     while (s->text_start >= s->text_end) // Search to beginning of buffer
     {
-        s->text_pos  = s->text_start--; // Start at current position
-        s->match_len = last_search.len; // No. of characters left to match
+        if (last_search.data == NULL)   // If no previous search string,
+        {
+            break;                      //  then fail
+        }
 
-        if ((s->match_buf = last_search.data) == NULL) // Start of match characters
+        if (s->type != SEARCH_C)        // Unless ::S, skip to next candidate
         {
-            break;                      // If no previous search string, then fail
+            rskip_search(s);
+
+            if (s->text_start < s->text_end)
+            {
+                break;
+            }
         }
 
+        s->text_pos = s->text_start--;  // Start at current position
+
         if (match_str(s))
         {
+            s->match_start = s->text_start + 1;
+
             return true;
         }
     }
@@ -508,16 +2468,27 @@ bool search_forward(struct search *s)
 
     while (s->text_start < s->text_end) // Search to end of buffer
     {
-        s->text_pos  = s->text_start++; // Start at current position
-        s->match_len = last_search.len; // No. of characters left to match
+        if (s->type != SEARCH_C)        // Unless ::S, skip to next candidate
+        {
+            skip_search(s);
+
+            if (s->text_start >= s->text_end)
+            {
+                break;
+            }
+        }
 
-        if ((s->match_buf = last_search.data) == NULL) // Start of match characters
+        s->text_pos = s->text_start++;  // Start at current position
+
+        if (last_search.data == NULL)   // If no previous search string,
         {
-            break;                      // If no previous search string, then fail
+            break;                      //  then fail
         }
 
         if (match_str(s))
         {
+            s->match_start = s->text_start - 1;
+
             // The following affects how much we move dot on multiple occurrence
             // searches. Normally we skip over the whole matched string when
             // proceeding to the nth search match. But if movedot is set, then
@@ -557,14 +2528,19 @@ bool search_loop(struct search *s)
     struct ifile *ifile = &ifiles[istream];
     struct ofile *ofile = &ofiles[ostream];
 
+    compile_search();
+
     // Start search at current position and see if we can get a match. If not,
     // increment position by one, and try again. If we reach the end of the
     // edit buffer without a match, then return failure, otherwise update our
-    // position and return success.
+    // position and return success. If we're looking for a later occurrence
+    // in a large buffer, we may split the search across multiple threads.
+
+    bool split = (s->count > 1 && begin_scan(s, f.ed.movedot));
 
     while (s->count > 0)
     {
-        if ((*s->search)(s))            // Successful search?
+        if (split ? next_scan(s) : (*s->search)(s)) // Successful search?
         {
             --s->count;                 // Yes, count down occurrence
         }
@@ -590,7 +2566,9 @@ bool search_loop(struct search *s)
                         s->text_start = -1;
                         s->text_end = -t->Z;
                     }
-                    else if (!next_page((int_t)0, t->Z, f.ctrl_e, (bool)true))
+                    else if (!page_forward(ofile->fp, -t->dot, t->Z - t->dot,
+                                           f.ctrl_e)
+                             && !skip_pages(ifile, ofile->fp))
                     {
                         return false;
                     }
@@ -626,7 +2604,7 @@ bool search_loop(struct search *s)
                     }
                     else
                     {
-                        if (!next_yank())
+                        if (!skip_pages(ifile, NULL))
                         {
                             return false;
                         }
@@ -654,12 +2632,18 @@ bool search_loop(struct search *s)
                 s->text_start = 0;      // Start at current character
                 s->text_end   = t->Z;
             }
+
+            split = (s->count > 1 && begin_scan(s, f.ed.movedot));
         }
     }
 
-    set_dot(t->dot + s->text_pos);
+    // The length of the matched text is not necessarily the length of the
+    // search string, since that may contain ^E constructs and other control
+    // characters.
+
+    last_len = (uint_t)(s->text_pos - s->match_start);
 
-    last_len = last_search.len;         // Save length of last search string
+    set_dot(t->dot + s->text_pos);
 
     return true;
 }
@@ -681,3 +2665,275 @@ void search_success(struct cmd *cmd)
         store_val(SUCCESS);
     }
 }
+
+
+///
+///  @brief    Skip ahead to the next position in the edit buffer at which a
+///            literal search string matches, using the Boyer-Moore-Horspool
+///            algorithm directly on the contiguous spans of the edit buffer.
+///            If we reach a position where the text to be compared is not
+///            contiguous (because it spans the gap in a gap buffer, or the end
+///            of a rope chunk), we stop there and leave it to match_str().
+///            If there is a search index, we use that instead to go to the
+///            next candidate.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void skip_literal(struct search *s)
+{
+    assert(s != NULL);                  // Error if no search block
+
+    uint_t offset, count;
+    const uint_t *list;
+
+    if (find_trigram(&offset, &list, &count))
+    {
+        // Go ahead to the first candidate at or after the current position.
+
+        uint_t pos = (uint_t)(t->dot + s->text_start) + offset;
+        uint_t i = next_ngram(list, count, pos);
+        int_t start = s->text_end;
+
+        if (i != count)
+        {
+            start = (int_t)list[i] - (int_t)offset - t->dot;
+        }
+
+        s->text_start = (start < s->text_end) ? start : s->text_end;
+
+        return;
+    }
+
+    uint_t len = program.count;
+    const uchar *text;
+    uint_t nbytes = span_edit(s->text_start, t->Z - t->dot, &text);
+
+    if (nbytes < len)
+    {
+        return;
+    }
+
+    // Find last position in span at which a match can start, allowing for
+    // any limit on how far we can search.
+
+    uint_t last = nbytes - len;
+
+    if ((int_t)last >= s->text_end - s->text_start)
+    {
+        last = (uint_t)(s->text_end - s->text_start - 1);
+    }
+
+    s->text_start += (int_t)find_literal(text, last);
+}
+
+
+///
+///  @brief    Get the next page that could contain a match for an N, _, or E_
+///            command. Pages that can't contain a match are read directly from
+///            the input file, and then either written out (for N) or discarded
+///            (for _ and E_), without being loaded into the edit buffer. The
+///            result is the same as paging through the file one page at a
+///            time and searching each page in turn.
+///
+///  @returns  true if we have a new page, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool skip_pages(struct ifile *ifile, FILE *fp)
+{
+    assert(ifile != NULL);
+
+    kill_edit();
+
+    for (;;)
+    {
+        if (fp != NULL)                 // Same checks as append()
+        {
+            f.ctrl_e = false;
+
+            if (ifile->fp == NULL || ifile->eof)
+            {
+                return false;
+            }
+        }
+
+        // Since the edit buffer is empty, any page no larger than the buffer
+        // can be loaded without resizing it. If the page is any larger, we
+        // load what we have read so far, and let append_edit() read the rest
+        // of it, just as if we had read the whole page that way.
+
+        bool more = read_page(ifile, t->size - 2);
+
+        if (fp == NULL && page_buf.len == 0)
+        {
+            return false;               // Same as next_yank()
+        }
+        else if (more || check_page((uchar *)page_buf.data, page_buf.len))
+        {
+            if (page_buf.len != 0)
+            {
+                (void)insert_edit(page_buf.data, (size_t)page_buf.len);
+            }
+
+            if (more)
+            {
+                (void)append_edit(ifile, (bool)false);
+            }
+
+            set_dot(t->B);
+
+            return true;
+        }
+
+        if (page_buf.len != 0 && page_count() == 0)
+        {
+            set_page(1);                // Same as loading the page
+        }
+
+        if (fp != NULL)
+        {
+            page_skip(fp, page_buf.data, page_buf.len, f.ctrl_e);
+        }
+    }
+}
+
+
+///
+///  @brief    Skip ahead to the next position in the edit buffer at which the
+///            compiled search string matches, using the DFA if we can. If not,
+///            we skip to the next position that matches the first element of
+///            the string. Either way, we scan a whole span of the buffer at a
+///            time, instead of trying to match the complete string at every
+///            position.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void skip_search(struct search *s)
+{
+    assert(s != NULL);                  // Error if no search block
+
+    if (program.literal)
+    {
+        skip_literal(s);
+
+        return;
+    }
+    else if (program.count == 0 || program.negate)
+    {
+        return;
+    }
+
+    const struct match *m = &program.match[0];
+
+    if (m->type == MATCH_ERROR)
+    {
+        return;
+    }
+
+    int_t start;
+    int found = dfa_search(s, &start);
+
+    if (found != -1)                    // Could we use the DFA?
+    {
+        s->text_start = found ? start : s->text_end;
+
+        return;
+    }
+
+    const uchar *text;
+    uint_t nbytes;
+
+    while ((nbytes = span_edit(s->text_start, s->text_end, &text)) != 0)
+    {
+        const uchar *p = find_first(text, nbytes);
+
+        if (p != NULL)
+        {
+            s->text_start += (int_t)(p - text);
+
+            return;
+        }
+
+        s->text_start += (int_t)nbytes;
+    }
+}
+
+
+#if     defined(THREADS)
+
+///
+///  @brief    Make sure that we have at least the specified no. of worker
+///            threads. Workers block all signals, so that signals are always
+///            handled by the main thread. If a thread can't be created, we
+///            just use fewer, since the main thread searches any chunks that
+///            the workers don't.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void start_workers(uint_t nworkers)
+{
+    if (pool.nworkers >= nworkers)
+    {
+        return;
+    }
+
+    if (!pool.forked)
+    {
+        (void)pthread_atfork(NULL, NULL, reset_workers);
+
+        pool.forked = true;
+    }
+
+    sigset_t all, old;
+
+    (void)sigfillset(&all);
+    (void)pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    while (pool.nworkers < nworkers
+           && !pthread_create(&pool.thread[pool.nworkers], NULL, scan_thread,
+                              NULL))
+    {
+        ++pool.nworkers;
+    }
+
+    (void)pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+
+///
+///  @brief    Tell worker threads to exit, and wait for them to do so.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void stop_workers(void)
+{
+    if (pool.nworkers == 0)
+    {
+        return;
+    }
+
+    (void)pthread_mutex_lock(&pool.lock);
+
+    pool.quit = true;
+
+    (void)pthread_cond_broadcast(&pool.start);
+    (void)pthread_mutex_unlock(&pool.lock);
+
+    for (uint_t i = 0; i < pool.nworkers; ++i)
+    {
+        (void)pthread_join(pool.thread[i], NULL);
+    }
+
+    pool.nworkers = 0;
+    pool.quit     = false;
+}
+
+#endif
@@ -149,6 +149,7 @@ struct flags f =                    ///< Global flag variables
 
     .e4.fence  = true,              // Display divider line
     .e4.status = true,              // Display status window
+    .e5 = 0,                        // Use one search thread per processor
 
     .ee = NUL,                      // No ESCape surrogate
     .eh.why = HELP_CONCISE,         // Use standard verbosity for error msgs.
@@ -227,6 +228,7 @@ int main(int argc, const char * const argv[])
                     read_cmd();         // Read input from terminal
                 }
 
+                check_edit();           // Check any mapped input file
                 init_x();               // Initialize expression stack
 
                 f.e0.exec = true;       // Command is in progress
@@ -297,6 +299,7 @@ static void exit_teco(void)
 
     reset_indirect();                   // Deallocate memory for EI commands
     reset_search();                     // Deallocate memory for last search
+    reset_macro();                      // Release caches held by macros
 
     exit_map();                         // Deallocate memory for map commands
     exit_error();                       // Deallocate memory for errors
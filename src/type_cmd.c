@@ -112,23 +112,25 @@ void exec_T(struct cmd *cmd)
 static void exec_type(int_t m, int_t n)
 {
     int last = EOF;
+    const uchar *text;
+    uint_t nbytes;
 
-    for (int_t i = m; i < n; ++i)
+    for (int_t i = m; (nbytes = span_edit(i, n, &text)) != 0;
+         i += (int_t)nbytes)
     {
-        int c = read_edit(i);
-
-        if (c == EOF)
-        {
-            break;
-        }
-        else if (f.e3.CR_type && c == LF && last != CR)
+        for (uint_t j = 0; j < nbytes; ++j)
         {
-            type_out(CR);
-        }
+            int c = text[j];
+
+            if (f.e3.CR_type && c == LF && last != CR)
+            {
+                type_out(CR);
+            }
 
-        type_out(c);
+            type_out(c);
 
-        last = c;
+            last = c;
+        }
     }
 }
 
@@ -108,16 +108,13 @@ void exec_X(struct cmd *cmd)
         delete_qtext(cmd->qindex);
     }
 
-    for (int_t i = m; i < n; ++i)
-    {
-        int c = read_edit(i);
+    const uchar *text;
+    uint_t nbytes;
 
-        if (c == EOF)
-        {
-            break;
-        }
-
-        append_qchr(cmd->qindex, c);
+    for (int_t i = m; (nbytes = span_edit(i, n, &text)) != 0;
+         i += (int_t)nbytes)
+    {
+        append_qtext(cmd->qindex, (const char *)text, nbytes);
     }
 }
 
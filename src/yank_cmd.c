@@ -55,7 +55,7 @@ void exec_EY(struct cmd *cmd)
         throw(E_NFI);                   // No file for input
     }
 
-    if (feof(ifile->fp))
+    if (ifile->eof)
     {
         if (cmd->colon)
         {
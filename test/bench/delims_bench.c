@@ -0,0 +1,214 @@
+///
+///  @file    delims_bench.c
+///  @brief   Benchmark for the delimiter and word counting functions in
+///           delims.c, which reports the throughput of each code path that
+///           the CPU supports in bytes per cycle.
+///
+///  @copyright 2019-2023 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+///  The functions for each code path are static, so we include delims.c
+///  rather than linking with it. Cycles are read with RDTSC where available
+///  (which counts at the nominal clock rate, not the current one); otherwise,
+///  nanoseconds are used instead.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../src/delims.c"
+
+#if     defined(__x86_64__) || defined(__i386__)
+
+#include <x86intrin.h>
+
+#define BENCH_UNIT  "cycle"         ///< Unit of time used
+
+#else
+
+#define BENCH_UNIT  "ns"            ///< Unit of time used
+
+#endif
+
+#define BENCH_SIZE  (1024 * 1024)   ///< Size of text block
+#define BENCH_LOOPS 200             ///< No. of passes over text block
+
+
+// Local functions
+
+static void bench_count(const char *name, const uchar *p,
+                        uint_t (*fn)(const uchar *p, uint_t nbytes));
+
+static void bench_words(const char *name, const uchar *p,
+                        uint_t (*fn)(const uchar *p, uint_t nbytes,
+                                     uint_t *ndelims, bool *space));
+
+static uint64_t get_ticks(void);
+
+
+///
+///  @brief    Time a function that counts delimiters.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void bench_count(const char *name, const uchar *p,
+                        uint_t (*fn)(const uchar *p, uint_t nbytes))
+{
+    uint_t ndelims = 0;
+    uint64_t start = get_ticks();
+
+    for (int i = 0; i < BENCH_LOOPS; ++i)
+    {
+        ndelims += (*fn)(p, BENCH_SIZE);
+    }
+
+    uint64_t ticks = get_ticks() - start;
+    double nbytes = (double)BENCH_SIZE * BENCH_LOOPS;
+
+    printf("count_%-8s %10u delims  %6.2f bytes/%s\n", name,
+           (uint)(ndelims / BENCH_LOOPS), nbytes / (double)ticks, BENCH_UNIT);
+}
+
+
+///
+///  @brief    Time a function that counts words and delimiters.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void bench_words(const char *name, const uchar *p,
+                        uint_t (*fn)(const uchar *p, uint_t nbytes,
+                                     uint_t *ndelims, bool *space))
+{
+    uint_t ndelims = 0;
+    uint_t nwords = 0;
+    uint64_t start = get_ticks();
+
+    for (int i = 0; i < BENCH_LOOPS; ++i)
+    {
+        bool space = true;
+
+        nwords += (*fn)(p, BENCH_SIZE, &ndelims, &space);
+    }
+
+    uint64_t ticks = get_ticks() - start;
+    double nbytes = (double)BENCH_SIZE * BENCH_LOOPS;
+
+    printf("words_%-8s %10u words   %6.2f bytes/%s\n", name,
+           (uint)(nwords / BENCH_LOOPS), nbytes / (double)ticks, BENCH_UNIT);
+}
+
+
+///
+///  @brief    Get current time, in cycles if possible.
+///
+///  @returns  No. of cycles (or nanoseconds).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t get_ticks(void)
+{
+#if     defined(__x86_64__) || defined(__i386__)
+
+    return (uint64_t)__rdtsc();
+
+#else
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+
+#endif
+}
+
+
+///
+///  @brief    Main program. Fills a block with text that has lines and words
+///            of varying length, then times each available code path.
+///
+///  @returns  EXIT_SUCCESS.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+int main(void)
+{
+    uchar *p = malloc(BENCH_SIZE);
+
+    if (p == NULL)
+    {
+        fprintf(stderr, "?Can't allocate %u bytes\n", (uint)BENCH_SIZE);
+
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+
+    for (uint_t i = 0; i < BENCH_SIZE; ++i)
+    {
+        int r = rand() % 64;
+
+        p[i] = (r == 0) ? LF : (r < 9) ? SPACE : (uchar)('a' + r % 26);
+    }
+
+    bench_count("scalar", p, count_scalar);
+
+#if     defined(__SSE2__)
+
+    bench_count("sse2", p, count_sse2);
+
+#endif
+
+#if     defined(DELIM_AVX2)
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        bench_count("avx2", p, count_avx2);
+    }
+
+#endif
+
+    bench_words("scalar", p, words_scalar);
+
+#if     defined(__SSE2__)
+
+    bench_words("sse2", p, words_sse2);
+
+#endif
+
+#if     defined(DELIM_AVX2)
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        bench_words("avx2", p, words_avx2);
+    }
+
+#endif
+
+    free(p);
+
+    return EXIT_SUCCESS;
+}